@@ -6,8 +6,15 @@
 
 #include <colmc/version.h>
 #include <colmc/setup.h>
+#include <colmc/static_styles.h>
 #include <colmc/sequences.h>
+#include <colmc/colors.h>
+#include <colmc/cursor.h>
 #include <colmc/raw_input.h>
+#include <colmc/coroutine.h>
 #include <colmc/term_size.h>
+#include <colmc/sgr.h>
+#include <colmc/screen.h>
+#include <colmc/log_sink.h>
 
 #endif
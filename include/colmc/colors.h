@@ -0,0 +1,137 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#ifndef colmc_colors_h_INCLUDED
+#define colmc_colors_h_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <colmc/sequences.h>
+
+#include <colmc/push_warnings.h>
+
+// Colors beyond the 8 basic ones of sequences.h: the 256 color palette of xterm and 24 bit
+// RGB ("truecolor"). The sequences of constant colors are built at compile time:
+//
+//   constexpr auto orange = colmc::fore::color(colmc::rgb{255, 128, 0});
+//   std::cout << orange << "text" << colmc::fore::reset;
+//
+// Not every terminal understands them, so detect_color_support() tells what the terminal
+// can do and fore_color()/back_color() write the nearest color it supports. The conversion
+// only uses lookup tables computed at compile time, so it is cheap enough for every cell of
+// a heatmap.
+
+namespace colmc {
+
+//! \brief 24 bit color
+struct rgb {
+	std::uint8_t r = 0;
+	std::uint8_t g = 0;
+	std::uint8_t b = 0;
+};
+
+//! \brief Index into the 256 color palette of xterm: 0-15 basic colors (8-15 bright),
+//! 16-231 6x6x6 color cube, 232-255 gray ramp
+struct color256 {
+	std::uint8_t index = 0;
+};
+
+//! \brief The colors a terminal understands
+enum class color_support {
+	none,      //!< No colors at all (e.g. TERM=dumb)
+	basic,     //!< The 8 basic colors and their bright variants
+	ansi256,   //!< The 256 color palette
+	truecolor  //!< 24 bit RGB
+};
+
+//! \brief Detects the color support of the terminal from the environment variables COLORTERM
+//! ("truecolor" or "24bit") and TERM (like "xterm-256color").
+color_support detect_color_support();
+
+//! \brief Like above, with the values of the variables given (nullptr if not set)
+color_support detect_color_support(const char* colorterm, const char* term);
+
+//! \brief Nearest color of the 256 color palette
+std::uint8_t to_ansi256(rgb c);
+
+//! \brief Nearest of the 16 basic colors (8-15 are the bright ones)
+std::uint8_t to_ansi16(rgb c);
+std::uint8_t to_ansi16(color256 c);
+
+//! \brief The RGB value of a palette color (as xterm shows it)
+rgb to_rgb(color256 c);
+
+//! \brief Maximum length of the sequences written by fore_color() and back_color()
+constexpr std::size_t max_color_sequence_len = 19u; // ESC [ 38 ; 2 ; rrr ; ggg ; bbb m
+
+//! \brief Write the sequence of the foreground/background color nearest to c that the
+//! terminal supports to out and return the end of the written range (nothing for
+//! color_support::none). out needs room for max_color_sequence_len chars.
+char* fore_color(char* out, rgb c, color_support support);
+char* back_color(char* out, rgb c, color_support support);
+char* fore_color(char* out, color256 c, color_support support);
+char* back_color(char* out, color256 c, color_support support);
+
+namespace detail {
+
+constexpr char* write_number_constexpr(char* out, unsigned value) { // std::to_chars isn't constexpr
+	char digits[3] = {};
+	std::size_t n = 0;
+	do {
+		digits[n++] = static_cast<char>('0' + (value % 10u));
+		value /= 10u;
+	} while (value > 0);
+	while (n > 0) {
+		*out++ = digits[--n];
+	}
+	return out;
+}
+
+constexpr sequence_buf extended_color_sequence(unsigned selector, unsigned mode, const std::uint8_t* values, std::size_t n) {
+	sequence_buf result;
+	char* p = result.chars;
+	*p++ = '\x1B';
+	*p++ = '[';
+	p = write_number_constexpr(p, selector);
+	*p++ = ';';
+	p = write_number_constexpr(p, mode);
+	for (std::size_t i = 0; i < n; ++i) {
+		*p++ = ';';
+		p = write_number_constexpr(p, values[i]);
+	}
+	*p++ = 'm';
+	result.len = static_cast<std::size_t>(p - result.chars);
+	return result;
+}
+
+}
+
+namespace fore {
+
+constexpr sequence_buf color(rgb c) {
+	const std::uint8_t values[3] = { c.r, c.g, c.b };
+	return detail::extended_color_sequence(38u, 2u, values, 3u);
+}
+
+constexpr sequence_buf color(color256 c) {
+	return detail::extended_color_sequence(38u, 5u, &c.index, 1u);
+}
+
+}
+
+namespace back {
+
+constexpr sequence_buf color(rgb c) {
+	const std::uint8_t values[3] = { c.r, c.g, c.b };
+	return detail::extended_color_sequence(48u, 2u, values, 3u);
+}
+
+constexpr sequence_buf color(color256 c) {
+	return detail::extended_color_sequence(48u, 5u, &c.index, 1u);
+}
+
+}
+
+}
+
+#include <colmc/pop_warnings.h>
+
+#endif
@@ -0,0 +1,203 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#ifndef colmc_coroutine_h_INCLUDED
+#define colmc_coroutine_h_INCLUDED
+
+// C++20 coroutine support for the raw input mode, e.g.:
+//
+//   my_task widget() { // my_task: any coroutine type, e.g. the one of your executor
+//       for (;;) {
+//           const colmc::key k = co_await colmc::next_key();
+//           ...
+//       }
+//   }
+//
+// The keys are handed out by a key_dispatcher. Its run_once() is a small built-in reactor
+// that waits for input. If the application has an event loop of its own, it watches
+// colmc::input_fd() instead and calls dispatch() when the fd is readable. The coroutines
+// are resumed by the thread that calls run_once() or dispatch(), so one thread can serve the
+// input of many widgets and the rendering. This header is empty before C++20.
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <coroutine>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <optional>
+#include <colmc/raw_input.h>
+
+#include <colmc/push_warnings.h>
+
+namespace colmc {
+
+class key_dispatcher {
+public:
+	//! \brief Awaitable returned by next_key()
+	class key_awaiter {
+	public:
+		explicit key_awaiter(key_dispatcher& dispatcher)
+			:m_dispatcher(dispatcher)
+		{
+		}
+
+		bool await_ready() const {
+			return ((!m_dispatcher.m_keys.empty()) || m_dispatcher.m_closed);
+		}
+
+		void await_suspend(std::coroutine_handle<> waiter) {
+			m_dispatcher.m_waiters.push_back(waiter);
+		}
+
+		//! \returns key_enum::no_key_pressed after close()
+		key await_resume() {
+			return m_dispatcher.pop();
+		}
+
+	private:
+		key_dispatcher& m_dispatcher;
+	};
+
+	//! \brief Awaitable range of keys: while (auto k = co_await stream.next()) { ... }
+	class key_stream {
+	public:
+		explicit key_stream(key_dispatcher& dispatcher)
+			:m_dispatcher(dispatcher)
+		{
+		}
+
+		struct optional_awaiter {
+			key_awaiter awaiter;
+
+			bool await_ready() const {
+				return awaiter.await_ready();
+			}
+
+			void await_suspend(std::coroutine_handle<> waiter) {
+				awaiter.await_suspend(waiter);
+			}
+
+			//! \returns std::nullopt after close()
+			std::optional<key> await_resume() {
+				const key k = awaiter.await_resume();
+				if (k.special == key_enum::no_key_pressed) {
+					return std::nullopt;
+				}
+				return k;
+			}
+		};
+
+		optional_awaiter next() {
+			return optional_awaiter{key_awaiter{m_dispatcher}};
+		}
+
+	private:
+		key_dispatcher& m_dispatcher;
+	};
+
+	//! \brief co_await next_key() suspends until a key is available
+	key_awaiter next_key() {
+		return key_awaiter{*this};
+	}
+
+	key_stream keys() {
+		return key_stream{*this};
+	}
+
+	//! \brief Reads the keys that are available (see read_keys()) and resumes the waiting
+	//! coroutines. To be called when input_fd() is readable. A key_enum::paste ends
+	//! the batch, so pasted_text() belongs to it while the coroutines run.
+	void dispatch() {
+		key buf[64];
+		std::size_t n;
+		do {
+			n = read_keys(buf, sizeof(buf) / sizeof(buf[0]));
+			m_keys.insert(m_keys.end(), buf, buf + n);
+		} while ((n == (sizeof(buf) / sizeof(buf[0]))) && (buf[n - 1u].special != key_enum::paste));
+		resume_waiters();
+	}
+
+	//! \brief Built-in reactor: waits at most timeout for input, then dispatches it.
+	//! \returns true if a key has been dispatched
+	bool run_once(std::chrono::milliseconds timeout) {
+		const key k = get_key(timeout);
+		if (k.special == key_enum::no_key_pressed) {
+			return false;
+		}
+		m_keys.push_back(k);
+		if (k.special != key_enum::paste) {
+			dispatch();
+		}
+		else {
+			resume_waiters();
+		}
+		return true;
+	}
+
+	//! \brief Hands out a key that didn't come from the terminal (e.g. a simulated one)
+	void post(const key& k) {
+		m_keys.push_back(k);
+		resume_waiters();
+	}
+
+	//! \brief Resumes all waiting coroutines with key_enum::no_key_pressed and lets
+	//! all further awaits return immediately
+	void close() {
+		m_closed = true;
+		while (!m_waiters.empty()) {
+			resume_next_waiter();
+		}
+	}
+
+	//! \brief true if coroutines are waiting for keys
+	bool has_waiters() const {
+		return !m_waiters.empty();
+	}
+
+private:
+	key pop() {
+		if (m_keys.empty()) {
+			return key{};
+		}
+		const key k = m_keys.front();
+		m_keys.pop_front();
+		return k;
+	}
+
+	void resume_next_waiter() {
+		const auto waiter = m_waiters.front();
+		m_waiters.pop_front();
+		waiter.resume();
+	}
+
+	void resume_waiters() {
+		while ((!m_keys.empty()) && (!m_waiters.empty())) {
+			resume_next_waiter(); // may await again (and take the next key right away)
+		}
+	}
+
+	std::deque<key> m_keys;
+	std::deque<std::coroutine_handle<>> m_waiters;
+	bool m_closed = false;
+};
+
+//! \brief The dispatcher used by next_key() and keys()
+inline key_dispatcher& default_key_dispatcher() {
+	static key_dispatcher dispatcher;
+	return dispatcher;
+}
+
+inline key_dispatcher::key_awaiter next_key() {
+	return default_key_dispatcher().next_key();
+}
+
+inline key_dispatcher::key_stream keys() {
+	return default_key_dispatcher().keys();
+}
+
+}
+
+#include <colmc/pop_warnings.h>
+
+#endif
+
+#endif
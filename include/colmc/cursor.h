@@ -0,0 +1,65 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#ifndef colmc_cursor_h_INCLUDED
+#define colmc_cursor_h_INCLUDED
+
+#include <cstddef>
+#include <colmc/sequences.h>
+
+#include <colmc/push_warnings.h>
+
+// cursor_planner remembers where the cursor is and moves it with the shortest byte
+// sequence: an absolute position, a relative move (up/down/forward/backward), CR, CR LF,
+// backspaces or by writing the cells in between again. Every byte counts on slow
+// connections like SSH sessions.
+
+namespace colmc {
+
+//! \brief Maximum length of the sequence written by cursor_planner::move_to()
+constexpr std::size_t max_motion_len = max_sequence_len;
+
+class cursor_planner {
+public:
+	//! \brief true if the position of the cursor is known
+	bool known() const {
+		return (m_x >= 0);
+	}
+
+	//! \brief Zero based column, -1 if unknown
+	int x() const {
+		return m_x;
+	}
+
+	//! \brief Zero based row, -1 if unknown
+	int y() const {
+		return m_y;
+	}
+
+	//! \brief The cursor has been moved to (x, y) by somebody else
+	void set_position(int x, int y);
+
+	//! \brief The position of the cursor is unknown, so the next move_to() is absolute
+	void invalidate() {
+		m_x = m_y = -1;
+	}
+
+	//! \brief Writes the shortest sequence that moves the cursor to (x, y) to out.
+	//! overwrite (optional) are the bytes that redraw the cells from the cursor up to x in
+	//! the current row as they are on the terminal, in the style that is currently active.
+	//! \returns the end of the written range; at most max_motion_len chars are written
+	char* move_to(char* out, int x, int y, const char* overwrite = nullptr, std::size_t overwrite_len = 0);
+
+	//! \brief Has to be called after text of num_columns columns has been written. The
+	//! position becomes unknown when the text reaches the right border (the terminal
+	//! may or may not have wrapped).
+	void advance(int num_columns, int screen_columns);
+
+private:
+	int m_x = -1;
+	int m_y = -1;
+};
+
+}
+
+#include <colmc/pop_warnings.h>
+
+#endif
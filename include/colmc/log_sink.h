@@ -0,0 +1,99 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#ifndef colmc_log_sink_h_INCLUDED
+#define colmc_log_sink_h_INCLUDED
+
+#include <cstddef>
+#include <string>
+#include <memory>
+#include <ostream>
+
+#include <colmc/push_warnings.h>
+
+// A log_sink lets many threads write colored lines at the same time without the lines
+// (or their escape sequences) getting mixed up:
+//
+//   colmc::log_sink log;
+//   log.line() << "<red>error:</> " << message;  // written when the statement ends
+//
+// Each thread formats its lines in a buffer of its own. Style tags (see add_style()) are
+// resolved per line with a style stack of the line, and a line that changed the style ends
+// with the default style again, so colors never bleed from one line into another. A finished
+// line is written with a single write(), which the kernel doesn't interleave with others
+// (for pipes only up to PIPE_BUF bytes; a longer line is written while the short ones wait).
+// Short lines take no lock at all, not even the styles are locked: each thread only marks
+// its write in a flag of its own, which a longer line waits for.
+// If the sink writes to stdout and config::strip_sequences applies to it, the lines are
+// written without escape sequences and style tags. The lines bypass the buffers of std::cout
+// and stdio: what is in there is flushed before the first line only, so flush std::cout
+// before a line if both are mixed later on (not needed under Windows).
+// Under Windows, the console colors are global state, so the lines are written one by one
+// and their escape sequences are translated for stdout and stderr alike (they are removed
+// if stderr is a console that can't be translated because stdout is redirected).
+
+namespace colmc {
+
+class log_sink {
+	struct formatter;
+
+public:
+	//! \brief A line being formatted. It is written when it is destroyed.
+	class log_line {
+	public:
+		explicit log_line(log_sink& sink);
+		log_line(log_line&& other) noexcept;
+		log_line(const log_line&) = delete;
+		log_line& operator=(const log_line&) = delete;
+		log_line& operator=(log_line&&) = delete;
+		~log_line();
+
+		template<typename T>
+		log_line& operator<<(const T& value) {
+			*m_stream << value;
+			return *this;
+		}
+
+		log_line& operator<<(std::ostream& (*manipulator)(std::ostream&)) {
+			*m_stream << manipulator;
+			return *this;
+		}
+
+	private:
+		log_sink* m_sink;
+		formatter* m_formatter;
+		std::unique_ptr<formatter> m_own_formatter; // if a line is started while another one of the thread is still formatted
+		std::ostream* m_stream;
+	};
+
+	//! \param fd 1 for stdout, 2 for stderr or (POSIX only) any other file descriptor
+	explicit log_sink(int fd = 1)
+		:m_fd(fd)
+	{
+	}
+
+	log_sink(const log_sink&) = delete;
+	log_sink& operator=(const log_sink&) = delete;
+
+	//! \brief Starts a line. A trailing newline is added if the text doesn't end with one.
+	log_line line() {
+		return log_line{*this};
+	}
+
+	//! \brief Writes a complete line
+	void write_line(const char* p, std::size_t n);
+
+	void write_line(const std::string& text) {
+		write_line(text.data(), text.size());
+	}
+
+private:
+	static formatter& thread_formatter();
+	void write_line(formatter& f, const char* p, std::size_t n);
+
+	int m_fd;
+};
+
+}
+
+#include <colmc/pop_warnings.h>
+
+#endif
@@ -4,7 +4,10 @@
 
 #include <string>
 #include <cstring>
+#include <cstddef>
+#include <cstdint>
 #include <ostream>
+#include <chrono>
 
 #include <colmc/push_warnings.h>
 
@@ -33,7 +36,23 @@ enum class key_enum {
 	home,           //!< HOME key
 	end,            //!< END key
 	page_up,        //!< PAGE_UP key
-	page_down       //!< PAGE_DOWN key
+	page_down,      //!< PAGE_DOWN key
+	begin,          //!< Center key (5) of the keypad
+	f1,             //!< Function keys
+	f2,
+	f3,
+	f4,
+	f5,
+	f6,
+	f7,
+	f8,
+	f9,
+	f10,
+	f11,
+	f12,
+	mouse,          //!< A mouse event coded inside key::mouse (see config::mouse_tracking)
+	resize,         //!< The terminal has been resized (see config::resize_events and estimate_terminal_size())
+	paste           //!< Text pasted in bracketed paste mode (see config::bracketed_paste), see pasted_text()
 };
 
 //! \brief to convert a key_enum to a string
@@ -53,6 +72,22 @@ inline std::string to_string(key_enum e) {
 		COLMC_ENTRY(end);
 		COLMC_ENTRY(page_up);
 		COLMC_ENTRY(page_down);
+		COLMC_ENTRY(begin);
+		COLMC_ENTRY(f1);
+		COLMC_ENTRY(f2);
+		COLMC_ENTRY(f3);
+		COLMC_ENTRY(f4);
+		COLMC_ENTRY(f5);
+		COLMC_ENTRY(f6);
+		COLMC_ENTRY(f7);
+		COLMC_ENTRY(f8);
+		COLMC_ENTRY(f9);
+		COLMC_ENTRY(f10);
+		COLMC_ENTRY(f11);
+		COLMC_ENTRY(f12);
+		COLMC_ENTRY(mouse);
+		COLMC_ENTRY(resize);
+		COLMC_ENTRY(paste);
 		default: break;
 	}
 #undef COLMC_ENTRY
@@ -115,33 +150,114 @@ inline std::ostream& operator<<(std::ostream& o, const utf8_char& c) {
 	return o;
 }
 
+//! \brief Bits of key::modifiers (same values as in the xterm sequences minus one)
+namespace modifier {
+
+constexpr std::uint8_t none  = 0u;
+constexpr std::uint8_t shift = 1u;
+constexpr std::uint8_t alt   = 2u;
+constexpr std::uint8_t ctrl  = 4u;
+constexpr std::uint8_t meta  = 8u;
+
+}
+
+//! \brief Mouse button of a mouse_event
+enum class mouse_button: std::uint8_t {
+	none,        //!< Motion without a pressed button
+	left,
+	middle,
+	right,
+	wheel_up,
+	wheel_down,
+	wheel_left,
+	wheel_right,
+	back,        //!< Button 8
+	forward,     //!< Button 9
+	other        //!< Buttons 10 and 11
+};
+
+//! \brief to convert a mouse_button to a string
+inline std::string to_string(mouse_button b) {
+#define COLMC_ENTRY(e) case mouse_button::e: return #e
+	switch(b) {
+		COLMC_ENTRY(none);
+		COLMC_ENTRY(left);
+		COLMC_ENTRY(middle);
+		COLMC_ENTRY(right);
+		COLMC_ENTRY(wheel_up);
+		COLMC_ENTRY(wheel_down);
+		COLMC_ENTRY(wheel_left);
+		COLMC_ENTRY(wheel_right);
+		COLMC_ENTRY(back);
+		COLMC_ENTRY(forward);
+		COLMC_ENTRY(other);
+		default: break;
+	}
+#undef COLMC_ENTRY
+	return {};
+}
+
+//! \brief What happened with the mouse
+enum class mouse_action: std::uint8_t {
+	press,   //!< Also used for the wheel
+	release,
+	move     //!< Motion, with button being the held button (dragging) or mouse_button::none
+};
+
+//! \brief A mouse event reported by the terminal. The modifiers are in key::modifiers.
+struct mouse_event {
+	mouse_button button = mouse_button::none;
+	mouse_action action = mouse_action::press;
+	std::uint16_t x = 0; //!< Zero-based column
+	std::uint16_t y = 0; //!< Zero-based row
+};
+
 //! \brief Representation of a hit key on the keyboard
 struct key {
 	key_enum special = key_enum::no_key_pressed;
 	utf8_char regular; //!< This field is used when special is key_enum::regular
+	std::uint8_t modifiers = modifier::none; //!< Bits of namespace modifier, e.g. for CTRL+RIGHT or ALT+x
+	mouse_event mouse; //!< This field is used when special is key_enum::mouse
 
 	operator std::string() const {
+		std::string result;
+		if ((modifiers & modifier::shift) != 0) {
+			result += "shift+";
+		}
+		if ((modifiers & modifier::alt) != 0) {
+			result += "alt+";
+		}
+		if ((modifiers & modifier::ctrl) != 0) {
+			result += "ctrl+";
+		}
+		if ((modifiers & modifier::meta) != 0) {
+			result += "meta+";
+		}
 		if (special == key_enum::regular) {
-			return regular;
+			return result + static_cast<std::string>(regular);
 		}
-		return to_string(special);
+		if (special == key_enum::mouse) {
+			static const char* const actions[] = { "press", "release", "move" };
+			return result + "mouse " + to_string(mouse.button) + ' ' + actions[static_cast<int>(mouse.action)] +
+			       ' ' + std::to_string(mouse.x) + ',' + std::to_string(mouse.y);
+		}
+		return result + to_string(special);
 	}
 };
 
 //! \brief For easy streaming of key
 inline std::ostream& operator<<(std::ostream& o, const key& c) {
-	if (c.special == key_enum::regular) {
-		o << c.regular;
-	}
-	else {
-		o << c.special;
-	}
+	o << static_cast<std::string>(c);
 	return o;
 }
 
+// The comparisons with a char, UTF-8 sequence or key_enum are only true for keys
+// pressed without modifiers, so ALT+x is not equal to 'x'. Mouse events are the
+// exception: they are equal to key_enum::mouse with the modifiers held while clicking.
+
 //! \brief for easy comparison of a hit key to an ASCII constant
 inline bool operator==(const key& u, char c) {
-	return ((u.special == key_enum::regular) && (u.regular == c));
+	return ((u.special == key_enum::regular) && (u.modifiers == modifier::none) && (u.regular == c));
 }
 
 inline bool operator!=(const key& u, char c) {
@@ -160,6 +276,7 @@ inline bool operator!=(char c, const key& u) {
 inline bool operator==(const key& u, const char* p) {
 	const auto len = std::strlen(p);
 	return ((u.special == key_enum::regular) &&
+		    (u.modifiers == modifier::none) &&
 		    (std::strlen(u.regular.bytes) == len) &&
 		    (std::memcmp(u.regular.bytes, p, len) == 0));
 }
@@ -177,7 +294,8 @@ inline bool operator!=(const char* p, const key& u) {
 }
 
 inline bool operator==(const key& u, key_enum e) {
-	return ((u.special == e));
+	const bool ignores_modifiers = (e == key_enum::mouse) || (e == key_enum::resize) || (e == key_enum::paste);
+	return ((u.special == e) && (ignores_modifiers || (u.modifiers == modifier::none)));
 }
 
 inline bool operator!=(const key& u, key_enum e) {
@@ -185,11 +303,11 @@ inline bool operator!=(const key& u, key_enum e) {
 }
 
 inline bool operator==(key_enum e, const key& u) {
-	return (e == u);
+	return (u == e);
 }
 
 inline bool operator!=(key_enum e, const key& u) {
-	return !(e == u);
+	return !(u == e);
 }
 
 //! \brief returns true when a key was hit
@@ -202,6 +320,33 @@ extern bool key_pressed();
 //!                            When false and no key was hit, key_enum::no_key_pressed is returned
 extern key get_key(bool block_until_pressed = true);
 
+//! \brief Returns the pressed key, waiting at most timeout for it (key_enum::no_key_pressed
+//! if none was hit). The process sleeps while waiting.
+//! Only available when colmc::setup was configured with raw_input_mode = true
+extern key get_key(std::chrono::milliseconds timeout);
+
+//! \brief Moves up to max_keys pressed keys into keys and returns their number. Never blocks.
+//! With config::input_thread (POSIX only), the keys are decoded by a background thread and
+//! this function takes no lock, so it can be called every frame. It only makes a syscall (to
+//! wake the thread) if the thread waits because more keys were hit than have been taken.
+//! Only available when colmc::setup was configured with raw_input_mode = true
+extern std::size_t poll_keys(key* keys, std::size_t max_keys);
+
+//! \brief The text of the key_enum::paste returned last. The buffer is reused by the next
+//! paste, so it is only valid until then. poll_keys() and read_keys() return at most one
+//! paste per call (as their last key).
+extern const std::string& pasted_text();
+
+//! \brief File descriptor that becomes readable when keys are available, for integrating
+//! colmc into an existing poll/epoll/io_uring loop. Call read_keys() when it is ready.
+//! \returns -1 if not in raw input mode or on Windows
+extern int input_fd();
+
+//! \brief Reads the input that is available at input_fd() (without blocking) and moves up to
+//! max_keys decoded keys into keys. If max_keys keys are returned, more may be available
+//! without input_fd() becoming ready again, so call it again until it returns less.
+extern std::size_t read_keys(key* keys, std::size_t max_keys);
+
 }
 
 #include <colmc/pop_warnings.h>
@@ -0,0 +1,104 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#ifndef colmc_screen_h_INCLUDED
+#define colmc_screen_h_INCLUDED
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <colmc/term_size.h>
+#include <colmc/sgr.h>
+#include <colmc/cursor.h>
+
+#include <colmc/push_warnings.h>
+
+// colmc::screen is a double-buffered grid of character cells for dashboards and other
+// full screen output. The application draws into the back buffer, present() compares it
+// with what is already on the terminal (the front buffer) and only writes the changed cells.
+// Every glyph is expected to occupy exactly one terminal column.
+
+namespace colmc {
+
+//! \brief One character cell: a UTF-8 encoded glyph and its style in 8 bytes
+struct cell {
+	char glyph[4] = { ' ', '\0', '\0', '\0' }; //!< 1-4 bytes, unused bytes are zero
+	cell_style style;
+	std::uint8_t reserved = 0; //!< keeps the padding defined, so cells can be compared bytewise
+};
+
+static_assert(sizeof(cell) == 8u, "cells are meant to be compact");
+
+inline bool operator==(const cell& a, const cell& b) {
+	return (std::memcmp(&a, &b, sizeof(cell)) == 0);
+}
+
+inline bool operator!=(const cell& a, const cell& b) {
+	return !(a == b);
+}
+
+class screen {
+public:
+	//! \brief Creates a screen of the size of the terminal (or 80x25 if that is unknown)
+	screen();
+
+	explicit screen(terminal_size size);
+
+	int columns() const {
+		return m_size.columns;
+	}
+
+	int rows() const {
+		return m_size.rows;
+	}
+
+	//! \brief Changes the size of both buffers; the next present() redraws everything
+	void resize(terminal_size size);
+
+	//! \brief Fills the back buffer with blanks of the given style
+	void clear(cell_style style = {});
+
+	//! \brief Access to a cell of the back buffer. x and y are zero based and have to be in range.
+	cell& at(int x, int y) {
+		return m_back[static_cast<std::size_t>(y) * static_cast<std::size_t>(m_size.columns) + static_cast<std::size_t>(x)];
+	}
+
+	const cell& at(int x, int y) const {
+		return m_back[static_cast<std::size_t>(y) * static_cast<std::size_t>(m_size.columns) + static_cast<std::size_t>(x)];
+	}
+
+	//! \brief Writes UTF-8 text into the back buffer, one code point per cell, starting
+	//! at (x, y). The text is clipped at the right border.
+	//! \returns the number of cells written
+	int print(int x, int y, const std::string& utf8_text, cell_style style = {});
+
+	//! \brief Writes the differences between the back buffer and the terminal to stdout, after
+	//! what std::cout has buffered. It doesn't go through std::cout, so a glyph like '<' is never
+	//! taken for the beginning of a style tag.
+	void present();
+
+	//! \brief Like above, but writes to o and flushes it. o mustn't rewrite style tags.
+	void present(std::ostream& o);
+
+	//! \brief Forgets what is on the terminal, so the next present() redraws everything
+	void invalidate() {
+		m_full_redraw = true;
+	}
+
+private:
+	void render(); // the differences to m_out
+
+	terminal_size m_size;
+	std::vector<cell> m_front; // what is on the terminal
+	std::vector<cell> m_back;  // what the application has drawn
+	std::string m_out;         // kept as member to avoid repetitive allocations
+	sgr_tracker m_sgr;
+	cursor_planner m_cursor;
+	bool m_full_redraw = true;
+};
+
+}
+
+#include <colmc/pop_warnings.h>
+
+#endif
@@ -2,8 +2,10 @@
 #ifndef colmc_sequences_h_INCLUDED
 #define colmc_sequences_h_INCLUDED
 
+#include <cstddef>
 #include <string>
-#include <sstream>
+#include <ostream>
+#include <charconv>
 
 #include <colmc/push_warnings.h>
 
@@ -48,46 +50,71 @@ constexpr char reset[]      = "\x1B[49m";
 
 }
 
+//! \brief Maximum length of the sequences written by the functions below
+//! (the longest is goto_xy with two 10 digit numbers)
+constexpr std::size_t max_sequence_len = 24u;
+
+namespace detail {
+
+template<typename OutputIt>
+OutputIt write_number(OutputIt out, unsigned value) {
+	char digits[10];
+	const auto result = std::to_chars(digits, digits + sizeof(digits), value); // neither allocates nor uses the locale
+	for (const char* p = digits; p != result.ptr; ++p) {
+		*out++ = *p;
+	}
+	return out;
+}
+
+template<typename OutputIt>
+OutputIt write_csi(OutputIt out, unsigned param, char command) {
+	*out++ = '\x1B';
+	*out++ = '[';
+	out = write_number(out, param);
+	*out++ = command;
+	return out;
+}
+
+}
+
+// The following overloads write the sequence to an output iterator (or plain char buffer
+// with room for at least max_sequence_len chars) and return the end of the written range.
+// They never allocate, so they are meant for code that emits lots of sequences, like a
+// full screen redraw.
+
 //! \brief x and y are zero based! ANSI is one-based, so this
 //! function adds one
-inline std::string goto_xy(int x, int y) {
-	std::ostringstream oss;
+template<typename OutputIt>
+OutputIt goto_xy(OutputIt out, int x, int y) {
 	if ((x >= 0) && (y >= 0)) {
-		oss << "\x1B[" << (y + 1) << ';' << (x + 1) << 'H';
+		*out++ = '\x1B';
+		*out++ = '[';
+		out = detail::write_number(out, static_cast<unsigned>(y) + 1u);
+		*out++ = ';';
+		out = detail::write_number(out, static_cast<unsigned>(x) + 1u);
+		*out++ = 'H';
 	}
-	return oss.str();
+	return out;
 }
 
-inline std::string up(int n) {
-	std::ostringstream oss;
-	if (n > 0) {
-		oss << "\x1B[" << n << 'A';
-	}
-	return oss.str();
+template<typename OutputIt>
+OutputIt up(OutputIt out, int n) {
+	return (n > 0) ? detail::write_csi(out, static_cast<unsigned>(n), 'A') : out;
 }
 
-inline std::string down(int n) {
-	std::ostringstream oss;
-	if (n > 0) {
-		oss << "\x1B[" << n << 'B';
-	}
-	return oss.str();
+template<typename OutputIt>
+OutputIt down(OutputIt out, int n) {
+	return (n > 0) ? detail::write_csi(out, static_cast<unsigned>(n), 'B') : out;
 }
 
-inline std::string forward(int n) {
-	std::ostringstream oss;
-	if (n > 0) {
-		oss << "\x1B[" << n << 'C';
-	}
-	return oss.str();
+template<typename OutputIt>
+OutputIt forward(OutputIt out, int n) {
+	return (n > 0) ? detail::write_csi(out, static_cast<unsigned>(n), 'C') : out;
 }
 
-inline std::string backward(int n) {
-	std::ostringstream oss;
-	if (n > 0) {
-		oss << "\x1B[" << n << 'D';
-	}
-	return oss.str();
+template<typename OutputIt>
+OutputIt backward(OutputIt out, int n) {
+	return (n > 0) ? detail::write_csi(out, static_cast<unsigned>(n), 'D') : out;
 }
 
 enum class clear_screen_mode: int {
@@ -96,10 +123,9 @@ enum class clear_screen_mode: int {
 	entire_screen                  = 2
 };
 
-inline std::string clear_screen(clear_screen_mode mode = clear_screen_mode::entire_screen) {
-	std::ostringstream oss;
-	oss << "\x1B[" << static_cast<int>(mode) << 'J';
-	return oss.str();
+template<typename OutputIt>
+OutputIt clear_screen(OutputIt out, clear_screen_mode mode = clear_screen_mode::entire_screen) {
+	return detail::write_csi(out, static_cast<unsigned>(mode), 'J');
 }
 
 enum class clear_line_mode: int {
@@ -108,10 +134,108 @@ enum class clear_line_mode: int {
 	entire_line                  = 2
 };
 
+template<typename OutputIt>
+OutputIt clear_line(OutputIt out, clear_line_mode mode = clear_line_mode::entire_line) {
+	return detail::write_csi(out, static_cast<unsigned>(mode), 'K');
+}
+
+//! \brief Escape sequence with fixed capacity that lives on the stack.
+//! Returned by the functions in namespace colmc::fixed.
+struct sequence_buf {
+	char chars[max_sequence_len + 1u] = { '\0' }; // sequence and null terminator
+	std::size_t len = 0;
+
+	const char* c_str() const {
+		return chars;
+	}
+
+	std::size_t size() const {
+		return len;
+	}
+
+	operator std::string() const {
+		return std::string{chars, len};
+	}
+};
+
+inline std::ostream& operator<<(std::ostream& o, const sequence_buf& s) {
+	o.write(s.chars, static_cast<std::streamsize>(s.len));
+	return o;
+}
+
+namespace detail {
+
+template<typename Func>
+sequence_buf build_sequence(Func&& write) {
+	sequence_buf result;
+	result.len = static_cast<std::size_t>(write(result.chars) - result.chars);
+	return result;
+}
+
+}
+
+namespace fixed {
+
+inline sequence_buf goto_xy(int x, int y) {
+	return colmc::detail::build_sequence([=](char* p) { return colmc::goto_xy(p, x, y); });
+}
+
+inline sequence_buf up(int n) {
+	return colmc::detail::build_sequence([=](char* p) { return colmc::up(p, n); });
+}
+
+inline sequence_buf down(int n) {
+	return colmc::detail::build_sequence([=](char* p) { return colmc::down(p, n); });
+}
+
+inline sequence_buf forward(int n) {
+	return colmc::detail::build_sequence([=](char* p) { return colmc::forward(p, n); });
+}
+
+inline sequence_buf backward(int n) {
+	return colmc::detail::build_sequence([=](char* p) { return colmc::backward(p, n); });
+}
+
+inline sequence_buf clear_screen(clear_screen_mode mode = clear_screen_mode::entire_screen) {
+	return colmc::detail::build_sequence([=](char* p) { return colmc::clear_screen(p, mode); });
+}
+
+inline sequence_buf clear_line(clear_line_mode mode = clear_line_mode::entire_line) {
+	return colmc::detail::build_sequence([=](char* p) { return colmc::clear_line(p, mode); });
+}
+
+}
+
+// The std::string variants are kept for convenience
+
+//! \brief x and y are zero based! ANSI is one-based, so this
+//! function adds one
+inline std::string goto_xy(int x, int y) {
+	return fixed::goto_xy(x, y);
+}
+
+inline std::string up(int n) {
+	return fixed::up(n);
+}
+
+inline std::string down(int n) {
+	return fixed::down(n);
+}
+
+inline std::string forward(int n) {
+	return fixed::forward(n);
+}
+
+inline std::string backward(int n) {
+	return fixed::backward(n);
+}
+
+inline std::string clear_screen(clear_screen_mode mode = clear_screen_mode::entire_screen) {
+	return fixed::clear_screen(mode);
+}
+
 inline std::string clear_line(clear_line_mode mode = clear_line_mode::entire_line) {
-	std::ostringstream oss;
-	oss << "\x1B[" << static_cast<int>(mode) << 'K';
-	return oss.str();
+	return fixed::clear_line(mode);
 }
 
 }
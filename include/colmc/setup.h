@@ -2,7 +2,10 @@
 #ifndef colmc_setup_h_INCLUDED
 #define colmc_setup_h_INCLUDED
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include <colmc/push_warnings.h>
@@ -10,18 +13,76 @@
 namespace colmc {
 
 struct config {
-	bool win_utf8       = true;  //!< Convert UTF-8 to UTF-16 under Windows and map cout/cin to wcout/wcin
-	bool raw_input_mode = false; //!< If true, see <colmc/raw_input.h> for details on how to use this mode
-	bool allow_styles   = false; //!< Allow styles (see below)
+	bool win_utf8        = true;  //!< Convert UTF-8 to UTF-16 under Windows and map cout/cin to wcout/wcin
+	bool raw_input_mode  = false; //!< If true, see <colmc/raw_input.h> for details on how to use this mode
+	bool allow_styles    = false; //!< Allow styles (see below)
+	bool input_thread    = false; //!< Decode the keys in a background thread in raw input mode, see poll_keys() (POSIX only)
+	bool bracketed_paste = false; //!< Deliver pasted text as one key_enum::paste in raw input mode (POSIX only)
+	bool resize_events   = false; //!< Report terminal resizes as key_enum::resize in raw input mode (POSIX only).
+	                              //!< Without input_thread, input_fd() doesn't become ready for them.
+	bool mouse_tracking  = false; //!< Report mouse clicks, drags and the wheel as key_enum::mouse in raw input mode (POSIX only)
+	bool minimize_sgr    = false; //!< Drop SGR sequences (colors) that change nothing and merge adjacent ones (not on Windows)
+	bool async_output    = false; //!< Write stdout in a background thread, see flush_and_wait() (not on Windows)
+	unsigned async_interval_ms = 10u; //!< With async_output: how long output is collected before it is written
+	bool thread_local_styles = false; //!< Keep the style stack (nested style tags) per thread instead of per stream
+	bool strip_sequences = false; //!< Remove escape sequences and style tags from std::cout if it isn't a terminal, and the
+	                              //!< colors if the environment variable NO_COLOR is set (POSIX only). Off by default, as
+	                              //!< it also removes the colors for a pager like less -R.
 };
 
 extern void setup(config cfg = config{});
 
+//! \brief Flushes std::cout and, with config::async_output, waits until everything written
+//! so far has reached the terminal, e.g. before the process forks or hands over the terminal
+extern void flush_and_wait();
+
 bool add_style(const std::string& tag_name, const std::string& escape_sequence);
 bool remove_style(const std::string& tag_name);
 std::string get_style(const std::string& tag_name);
+//! \brief Copy of a style stack: the names of the styles currently in effect, innermost last.
+//! It is small and doesn't allocate; the names stay valid until the end of the program, those
+//! of tags of unknown styles as long as the view.
+class style_stack_view {
+public:
+	static constexpr std::size_t max_size = 32u; //!< deeper nested styles aren't included
+	static constexpr std::size_t max_name_len = 15u; //!< the longest name a style tag can have
+
+	std::size_t size() const {
+		return m_size;
+	}
+
+	bool empty() const {
+		return (m_size == 0);
+	}
+
+	//! \brief Name of the i-th style
+	std::string_view operator[](std::size_t i) const;
+
+	operator std::vector<std::string>() const {
+		std::vector<std::string> result;
+		for (std::size_t i = 0; i < m_size; ++i) {
+			result.emplace_back((*this)[i]);
+		}
+		return result;
+	}
+
+private:
+	friend class style_stack;
+
+	std::uint32_t m_ids[max_size] = {};
+	char m_unknown_names[max_size][max_name_len] = {}; // the names of the tags of unknown styles
+	std::uint8_t m_unknown_name_lens[max_size] = {};
+	std::size_t m_size = 0;
+};
+
+//! \brief The names of the styles in the style stack of std::cout (or of the calling thread with
+//! config::thread_local_styles), innermost last. Call it from the thread writing to std::cout,
+//! as the stack isn't synchronized.
 std::vector<std::string> get_current_style_stack();
 
+//! \brief Like get_current_style_stack(), but without allocating
+style_stack_view get_current_style_stack_view();
+
 }
 
 #include <colmc/pop_warnings.h>
@@ -0,0 +1,107 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#ifndef colmc_sgr_h_INCLUDED
+#define colmc_sgr_h_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+
+#include <colmc/push_warnings.h>
+
+// SGR ("select graphic rendition", ESC [ ... m) sequences set the colors and the
+// intensity of the text that follows. sgr_tracker remembers what the terminal has been
+// told already, so renderers and output filters only write sequences that really change
+// something, and only one sequence for several changes.
+
+namespace colmc {
+
+//! \brief The 8 basic colors (same order as the ANSI color codes) and the terminal default
+enum class color: std::uint8_t {
+	black   = 0,
+	red     = 1,
+	green   = 2,
+	yellow  = 3,
+	blue    = 4,
+	magenta = 5,
+	cyan    = 6,
+	white   = 7,
+	reset   = 9  //!< default color of the terminal
+};
+
+enum class intensity: std::uint8_t {
+	normal,
+	bright,
+	dim
+};
+
+struct cell_style {
+	color fore = color::reset;
+	color back = color::reset;
+	colmc::intensity intensity = intensity::normal;
+};
+
+inline bool operator==(const cell_style& a, const cell_style& b) {
+	return ((a.fore == b.fore) && (a.back == b.back) && (a.intensity == b.intensity));
+}
+
+inline bool operator!=(const cell_style& a, const cell_style& b) {
+	return !(a == b);
+}
+
+//! \brief Maximum length of the sequence written by sgr_tracker::commit()
+constexpr std::size_t max_sgr_len = 24u;
+
+class sgr_tracker {
+public:
+	//! \brief Requests the style for the text written next. Nothing is written yet.
+	void request(const cell_style& style) {
+		m_requested = style;
+		m_requested_keep = 0;
+		m_requested_untracked = false;
+	}
+
+	//! \brief Applies the parameters of an SGR sequence to the requested style.
+	//! Nothing is written yet.
+	//! \returns false (and changes nothing) if a parameter is not tracked (like underline or
+	//! 256 colors). The sequence has to be written as it is then, see pass_through().
+	bool request(const int* params, std::size_t n);
+
+	//! \brief Writes the shortest sequence that changes the terminal to the requested style
+	//! to out (nothing if the terminal already has it).
+	//! \returns the end of the written range; at most max_sgr_len chars are written
+	char* commit(char* out);
+
+	//! \brief Has to be called after a sequence that request() refused has been written
+	//! (after a commit()). Takes over what can be tracked of it.
+	void pass_through(const int* params, std::size_t n);
+
+	//! \brief The state of the terminal is unknown (e.g. somebody else wrote to it), so
+	//! the next commit() writes the full style
+	void invalidate();
+
+	//! \brief The terminal has been reset (ESC [ 0 m has been written by somebody else)
+	void reset();
+
+	const cell_style& requested() const {
+		return m_requested;
+	}
+
+	//! \brief true if commit() would write something
+	bool has_pending_change() const;
+
+private:
+	bool needs_reset() const;
+	bool differs(std::uint8_t part) const;
+
+	cell_style m_requested;
+	cell_style m_terminal;
+	std::uint8_t m_requested_keep = 0;   // parts that stay as they are on the terminal (bits of the part enum in sgr.cpp)
+	std::uint8_t m_terminal_unknown = 0; // parts of m_terminal that are not known
+	bool m_requested_untracked = false;  // untracked attributes (like underline) are wanted
+	bool m_terminal_untracked = false;   // untracked attributes may be active on the terminal
+};
+
+}
+
+#include <colmc/pop_warnings.h>
+
+#endif
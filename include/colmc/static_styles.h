@@ -0,0 +1,187 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#ifndef colmc_static_styles_h_INCLUDED
+#define colmc_static_styles_h_INCLUDED
+
+#include <cstddef>
+#include <stdexcept>
+#include <ostream>
+
+#include <colmc/push_warnings.h>
+
+// Style tags (see add_style() in setup.h) are looked up and replaced at run time
+// whenever the text is flushed. For string literals and styles known at build time,
+// COLMC_STYLED resolves the tags at compile time instead, e.g.:
+//
+//   constexpr colmc::static_style log_styles[] = {
+//       { "red",  colmc::fore::red },
+//       { "warn", colmc::fore::yellow }
+//   };
+//   std::printf(COLMC_STYLED(log_styles, "<red>ERR</> %s\n"), msg);
+//
+// The result is a plain C string that already contains the escape sequences, the same
+// ones the run-time rewriting would produce for a style stack that is empty at the
+// beginning of the literal. An unknown tag is a compile error.
+
+namespace colmc {
+
+//! \brief Entry of a style table known at compile time. The table has to be a
+//! constexpr array at namespace scope.
+struct static_style {
+	const char* name;
+	const char* escape_sequence;
+};
+
+//! \brief Null-terminated string of fixed length N, usable in constant expressions
+template<std::size_t N>
+struct static_string {
+	char chars[N + 1u] = {};
+
+	constexpr const char* c_str() const {
+		return chars;
+	}
+
+	constexpr std::size_t size() const {
+		return N;
+	}
+};
+
+template<std::size_t N>
+inline std::ostream& operator<<(std::ostream& o, const static_string<N>& s) {
+	o.write(s.chars, static_cast<std::streamsize>(N));
+	return o;
+}
+
+namespace detail {
+
+constexpr std::size_t max_static_style_depth = 32u;
+
+constexpr std::size_t string_length(const char* s) {
+	std::size_t n = 0;
+	while (s[n] != '\0') {
+		++n;
+	}
+	return n;
+}
+
+constexpr bool is_style_name_char(char c) {
+	return (((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')) || (c == '_'));
+}
+
+// Same rules as the run-time parsing: '<', an optional '/', [A-Za-z_]* and '>',
+// at most 16 chars in total. Returns 0 if [p, p + n) doesn't start with a tag.
+constexpr std::size_t style_tag_length(const char* p, std::size_t n) {
+	std::size_t i = 1u; // after '<'
+	if ((n == 0) || (p[0] != '<')) {
+		return 0;
+	}
+	if ((i < n) && (p[i] == '/')) {
+		++i;
+	}
+	while ((i < n) && (i < 16u) && is_style_name_char(p[i])) {
+		++i;
+	}
+	if ((i > 1u) && (i < n) && (p[i] == '>')) {
+		return i + 1u;
+	}
+	return 0;
+}
+
+template<std::size_t T>
+constexpr const char* find_static_style(const static_style (&table)[T], const char* name, std::size_t len) {
+	for (std::size_t i = 0; i < T; ++i) {
+		const char* candidate = table[i].name;
+		std::size_t j = 0;
+		while ((j < len) && (candidate[j] == name[j])) {
+			++j;
+		}
+		if ((j == len) && (candidate[j] == '\0')) {
+			return table[i].escape_sequence;
+		}
+	}
+	throw std::invalid_argument("colmc: unknown style tag in COLMC_STYLED literal");
+}
+
+// Only counts when out is nullptr
+struct styled_writer {
+	char* out = nullptr;
+	std::size_t size = 0;
+
+	constexpr void put(const char* s, std::size_t n) {
+		for (std::size_t i = 0; i < n; ++i) {
+			if (out != nullptr) {
+				out[size] = s[i];
+			}
+			++size;
+		}
+	}
+
+	constexpr void put(const char* s) {
+		put(s, string_length(s));
+	}
+};
+
+template<std::size_t T>
+constexpr void resolve_static_styles(const static_style (&table)[T], const char* p, std::size_t n, styled_writer& writer) {
+	const char* stack[max_static_style_depth] = {};
+	std::size_t depth = 0;
+	std::size_t i = 0;
+	while (i < n) {
+		const std::size_t len = style_tag_length(p + i, n - i);
+		if (len == 0) {
+			writer.put(p + i, 1u);
+			++i;
+			continue;
+		}
+		writer.put("\x1B[0m"); // reset style sequence
+		if (p[i + 1u] == '/') {
+			if (depth > 0) {
+				--depth;
+			}
+			if (depth > 0) {
+				writer.put(stack[depth - 1u]); // restore last style
+			}
+		}
+		else {
+			if (depth == max_static_style_depth) {
+				throw std::length_error("colmc: style tags nested too deep in COLMC_STYLED literal");
+			}
+			stack[depth] = find_static_style(table, p + i + 1u, len - 2u);
+			writer.put(stack[depth]);
+			++depth;
+		}
+		i += len;
+	}
+}
+
+}
+
+//! \brief Length of the literal after its style tags have been replaced
+template<std::size_t T, std::size_t L>
+constexpr std::size_t styled_size(const static_style (&table)[T], const char (&literal)[L]) {
+	detail::styled_writer writer{};
+	detail::resolve_static_styles(table, literal, L - 1u, writer);
+	return writer.size;
+}
+
+//! \brief Replaces the style tags of the literal. N has to be styled_size(table, literal).
+template<std::size_t N, std::size_t T, std::size_t L>
+constexpr static_string<N> styled(const static_style (&table)[T], const char (&literal)[L]) {
+	static_string<N> result{};
+	detail::styled_writer writer{result.chars, 0};
+	detail::resolve_static_styles(table, literal, L - 1u, writer);
+	return result;
+}
+
+}
+
+//! \brief Evaluates to a const char* with the style tags of the string literal
+//! replaced at compile time
+#define COLMC_STYLED(table, literal) \
+	([]() -> const char* { \
+		static constexpr auto colmc_styled_ = ::colmc::styled<::colmc::styled_size(table, literal)>(table, literal); \
+		return colmc_styled_.c_str(); \
+	}())
+
+#include <colmc/pop_warnings.h>
+
+#endif
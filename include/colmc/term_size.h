@@ -14,6 +14,8 @@ struct terminal_size {
 //! \brief As the name suggests, requests the OS to return the size of the current terminal,
 //!  if possible.
 //! If not possible, the parameter default_if_not_gettable is returned instead
+//! On POSIX, the size is cached after setup() and only asked for again after the terminal
+//! has been resized (SIGWINCH), so calling this often is cheap.
 terminal_size estimate_terminal_size(const terminal_size& default_if_not_gettable = {});
 
 }
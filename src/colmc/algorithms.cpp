@@ -0,0 +1,213 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#include <cstdint>
+#include <colmc/algorithms.h>
+
+#if defined(__x86_64__) || defined(_M_X64) // SSE2 is part of x86-64
+	#define COLMC_SCAN_X86
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+		#define COLMC_TARGET_AVX2
+	#else
+		#define COLMC_TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+	#define COLMC_SCAN_NEON
+	#include <arm_neon.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#endif
+#endif
+
+using namespace colmc;
+
+namespace {
+
+using scan_func = std::size_t (*)(const char* p, std::size_t n, char c);
+using scan_either_func = std::size_t (*)(const char* p, std::size_t n, char c1, char c2);
+
+struct scan_kernels {
+	scan_func count_until;
+	scan_either_func count_until_either;
+};
+
+std::size_t count_until_scalar(const char* p, std::size_t n, char c) {
+	const auto i = index_of(p, c, n); // memchr() is usually well optimized by the C library
+	return (i == no_pos) ? n : i;
+}
+
+std::size_t count_until_either_scalar(const char* p, std::size_t n, char c1, char c2) {
+	std::size_t i = 0;
+	while((i < n) && (p[i] != c1) && (p[i] != c2)) {
+		++i;
+	}
+	return i;
+}
+
+#if defined(COLMC_SCAN_X86) || defined(COLMC_SCAN_NEON)
+
+unsigned lowest_bit_index(std::uint64_t mask) {
+#ifdef _MSC_VER
+	unsigned long index = 0;
+	_BitScanForward64(&index, mask);
+	return static_cast<unsigned>(index);
+#else
+	return static_cast<unsigned>(__builtin_ctzll(mask));
+#endif
+}
+
+#endif
+
+#ifdef COLMC_SCAN_X86
+
+std::size_t count_until_sse2(const char* p, std::size_t n, char c) {
+	const __m128i needle = _mm_set1_epi8(c);
+	std::size_t i = 0;
+	for (; (i + 16u) <= n; i += 16u) {
+		const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+		const auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)));
+		if (mask != 0) {
+			return i + lowest_bit_index(mask);
+		}
+	}
+	return i + count_until_scalar(p + i, n - i, c);
+}
+
+std::size_t count_until_either_sse2(const char* p, std::size_t n, char c1, char c2) {
+	const __m128i needle1 = _mm_set1_epi8(c1);
+	const __m128i needle2 = _mm_set1_epi8(c2);
+	std::size_t i = 0;
+	for (; (i + 16u) <= n; i += 16u) {
+		const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+		const __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(chunk, needle1), _mm_cmpeq_epi8(chunk, needle2));
+		const auto mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+		if (mask != 0) {
+			return i + lowest_bit_index(mask);
+		}
+	}
+	return i + count_until_either_scalar(p + i, n - i, c1, c2);
+}
+
+COLMC_TARGET_AVX2 std::size_t count_until_avx2(const char* p, std::size_t n, char c) {
+	const __m256i needle = _mm256_set1_epi8(c);
+	std::size_t i = 0;
+	for (; (i + 64u) <= n; i += 64u) { // two vectors per round trip to keep both load ports busy
+		const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+		const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i + 32u));
+		const auto lo_mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, needle)));
+		const auto hi_mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, needle)));
+		const std::uint64_t mask = (static_cast<std::uint64_t>(hi_mask) << 32u) | lo_mask;
+		if (mask != 0) {
+			return i + lowest_bit_index(mask);
+		}
+	}
+	return i + count_until_sse2(p + i, n - i, c);
+}
+
+COLMC_TARGET_AVX2 std::size_t count_until_either_avx2(const char* p, std::size_t n, char c1, char c2) {
+	const __m256i needle1 = _mm256_set1_epi8(c1);
+	const __m256i needle2 = _mm256_set1_epi8(c2);
+	std::size_t i = 0;
+	for (; (i + 32u) <= n; i += 32u) {
+		const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+		const __m256i hits = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, needle1), _mm256_cmpeq_epi8(chunk, needle2));
+		const auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(hits));
+		if (mask != 0) {
+			return i + lowest_bit_index(mask);
+		}
+	}
+	return i + count_until_either_sse2(p + i, n - i, c1, c2);
+}
+
+bool cpu_has_avx2() {
+#ifdef _MSC_VER
+	int regs[4];
+	__cpuid(regs, 0);
+	if (regs[0] < 7) {
+		return false;
+	}
+	__cpuid(regs, 1);
+	const bool os_saves_ymm = ((regs[2] & (1 << 27)) != 0) && ((_xgetbv(0) & 0x6) == 0x6); // OSXSAVE and XMM/YMM state enabled
+	if (!os_saves_ymm) {
+		return false;
+	}
+	__cpuidex(regs, 7, 0);
+	return ((regs[1] & (1 << 5)) != 0);
+#else
+	__builtin_cpu_init();
+	return (__builtin_cpu_supports("avx2") != 0);
+#endif
+}
+
+scan_kernels select_kernels() {
+	if (cpu_has_avx2()) {
+		return { count_until_avx2, count_until_either_avx2 };
+	}
+	return { count_until_sse2, count_until_either_sse2 };
+}
+
+#elif defined(COLMC_SCAN_NEON)
+
+// 4 bits per byte of the comparison result (see "shift right and narrow" trick)
+std::uint64_t neon_mask(uint8x16_t hits) {
+	const uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(hits), 4);
+	return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+}
+
+std::size_t count_until_neon(const char* p, std::size_t n, char c) {
+	const uint8x16_t needle = vdupq_n_u8(static_cast<std::uint8_t>(c));
+	std::size_t i = 0;
+	for (; (i + 16u) <= n; i += 16u) {
+		const uint8x16_t chunk = vld1q_u8(reinterpret_cast<const std::uint8_t*>(p + i));
+		const std::uint64_t mask = neon_mask(vceqq_u8(chunk, needle));
+		if (mask != 0) {
+			return i + (lowest_bit_index(mask) / 4u);
+		}
+	}
+	return i + count_until_scalar(p + i, n - i, c);
+}
+
+std::size_t count_until_either_neon(const char* p, std::size_t n, char c1, char c2) {
+	const uint8x16_t needle1 = vdupq_n_u8(static_cast<std::uint8_t>(c1));
+	const uint8x16_t needle2 = vdupq_n_u8(static_cast<std::uint8_t>(c2));
+	std::size_t i = 0;
+	for (; (i + 16u) <= n; i += 16u) {
+		const uint8x16_t chunk = vld1q_u8(reinterpret_cast<const std::uint8_t*>(p + i));
+		const std::uint64_t mask = neon_mask(vorrq_u8(vceqq_u8(chunk, needle1), vceqq_u8(chunk, needle2)));
+		if (mask != 0) {
+			return i + (lowest_bit_index(mask) / 4u);
+		}
+	}
+	return i + count_until_either_scalar(p + i, n - i, c1, c2);
+}
+
+scan_kernels select_kernels() {
+	return { count_until_neon, count_until_either_neon }; // NEON is mandatory on AArch64
+}
+
+#else
+
+scan_kernels select_kernels() {
+	return { count_until_scalar, count_until_either_scalar };
+}
+
+#endif
+
+const scan_kernels& kernels() {
+	static const scan_kernels selected = select_kernels();
+	return selected;
+}
+
+}
+
+namespace colmc {
+
+std::size_t count_until(const char* p, std::size_t n, char c) {
+	return kernels().count_until(p, n, c);
+}
+
+std::size_t count_until_either(const char* p, std::size_t n, char c1, char c2) {
+	return kernels().count_until_either(p, n, c1, c2);
+}
+
+}
@@ -70,18 +70,41 @@ inline std::size_t find_end_of_style_sequence(const char* p, std::size_t n) {
 		  (p[i] != '>')) {
 		++i;
 	}
-	if ((i > 1) && (p[i] == '>')) {
+	if ((i > 1) && (i < n) && (p[i] == '>')) {
 		return i + 1u;
 	}
 	return invalid_end_of_sequence;
 }
 
-inline std::size_t count_until_esc(const char* p, std::size_t n) {
-	std::size_t i = 0;
-	while((i < n) && (p[i] != esc)) {
+// returns true when [p, p + n) is the beginning of a style tag that is cut off
+// by the end of the buffer (like "<gre" or "</"), so the rest may follow later.
+// It takes the same tags as find_end_of_style_sequence(): at most max_style_seq_len
+// chars before the '>'
+inline bool is_style_sequence_prefix(const char* p, std::size_t n) {
+	if ((n == 0) || (n > max_style_seq_len) || (p[0] != '<')) {
+		return false;
+	}
+	std::size_t i = 1u; // after '<'
+	if ((i < n) && (p[i] == '/')) {
+		++i;
+	}
+	while((i < n) &&
+		  (((p[i] >= 'a') && (p[i] <= 'z')) ||
+		   ((p[i] >= 'A') && (p[i] <= 'Z')) ||
+		   (p[i] == '_'))) {
 		++i;
 	}
-	return i;
+	return (i == n);
+}
+
+// Scanning kernels for the output filters (see algorithms.cpp). They use SSE2/AVX2
+// or NEON when the CPU supports it and fall back to plain loops otherwise.
+// Both return the number of bytes before the first match, or n if nothing matched.
+std::size_t count_until(const char* p, std::size_t n, char c);
+std::size_t count_until_either(const char* p, std::size_t n, char c1, char c2);
+
+inline std::size_t count_until_esc(const char* p, std::size_t n) {
+	return count_until(p, n, esc);
 }
 
 }
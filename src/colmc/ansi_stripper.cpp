@@ -0,0 +1,133 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <colmc/algorithms.h>
+#include <colmc/ansi_stripper.h>
+
+namespace colmc {
+
+namespace {
+
+bool is_sgr(const vt_sequence& seq) {
+	return (seq.kind == vt_kind::csi) && (seq.final == 'm') && (seq.private_marker == '\0') && (seq.num_intermediates == 0);
+}
+
+}
+
+// Gets the sequences from vt_tokenizer (and the control chars inside of them as text). With
+// strip_mode::sgr everything but the SGR sequences is written again.
+struct ansi_stripper::handler: vt_handler {
+	strip_mode mode;
+	std::vector<char>& out;
+
+	bool keeps_sequences() const {
+		return (mode == strip_mode::sgr);
+	}
+
+	void text(const char* p, std::size_t n) {
+		out.insert(out.end(), p, p + n);
+	}
+
+	void sequence(const vt_sequence& seq) {
+		if (keeps_sequences() && (!is_sgr(seq))) {
+			out.insert(out.end(), seq.raw_data(), seq.raw_data() + seq.raw_len);
+		}
+	}
+
+	void string_begin(const vt_sequence& seq) {
+		if (keeps_sequences()) {
+			out.insert(out.end(), seq.raw_data(), seq.raw_data() + seq.raw_len);
+		}
+	}
+
+	void string_data(const char* p, std::size_t n) {
+		if (keeps_sequences()) {
+			out.insert(out.end(), p, p + n);
+		}
+	}
+
+	void string_end(vt_string_end end) {
+		if (keeps_sequences()) {
+			const char* terminator = string_terminator(end);
+			out.insert(out.end(), terminator, terminator + std::strlen(terminator));
+		}
+	}
+};
+
+std::size_t ansi_stripper::count_plain(const char* p, std::size_t n) const {
+	return m_style_tags ? count_until_either(p, n, esc, '<') : count_until_esc(p, n);
+}
+
+// Handles the '<' at p[0] or tries to complete the tag kept back before with the beginning of
+// [p, p + n) (as style_tag_rewriter does). Returns the number of bytes taken; 0 if the kept
+// back part was regular text after all, which is written then.
+std::size_t ansi_stripper::take_tag(const char* p, std::size_t n, std::vector<char>& out) {
+	char combined[2u * max_style_seq_len];
+	const std::size_t taken = std::min(n, max_style_seq_len);
+	std::memcpy(combined, m_pending, m_pending_size);
+	std::memcpy(combined + m_pending_size, p, taken);
+	const std::size_t combined_size = m_pending_size + taken;
+	const std::size_t end = find_end_of_style_sequence(combined, combined_size);
+	if (end != invalid_end_of_sequence) {
+		const std::size_t taken_now = end - m_pending_size;
+		m_pending_size = 0;
+		return taken_now;
+	}
+	if (is_style_sequence_prefix(combined, combined_size)) { // cut off by the end of [p, p + n)
+		assert(taken == n);
+		std::memcpy(m_pending, combined, combined_size);
+		m_pending_size = combined_size;
+		return n;
+	}
+	if (m_pending_size > 0u) {
+		flush_pending(out); // the '<' is the only one in it, so [p, p + n) is scanned from the beginning
+		return 0;
+	}
+	out.push_back('<'); // a regular '<' inside text
+	return 1u;
+}
+
+void ansi_stripper::flush_pending(std::vector<char>& out) {
+	out.insert(out.end(), m_pending, m_pending + m_pending_size);
+	m_pending_size = 0;
+}
+
+void ansi_stripper::filter(const char* p, std::size_t n, std::vector<char>& out) {
+	handler h{{}, m_mode, out};
+	while (n > 0) {
+		std::size_t taken = 0;
+		if (!m_tokenizer.in_ground()) { // a sequence was cut off
+			taken = m_tokenizer.feed_sequence(p, n, h);
+		}
+		else if (m_pending_size > 0u) {
+			taken = take_tag(p, n, out);
+		}
+		else {
+			const std::size_t text = count_plain(p, n); // one scan for both, escape sequences and style tags
+			out.insert(out.end(), p, p + text);
+			p += text;
+			n -= text;
+			if (n == 0) {
+				break;
+			}
+			taken = (p[0] == esc) ? m_tokenizer.feed_sequence(p, n, h) : take_tag(p, n, out);
+		}
+		p += taken;
+		n -= taken;
+	}
+}
+
+void ansi_stripper::finish(std::vector<char>& out) {
+	if (m_mode == strip_mode::none) {
+		handler h{{}, m_mode, out};
+		m_tokenizer.finish(h); // an incomplete sequence is text
+	}
+	else {
+		vt_handler ignore; // the output must not get the ESC of an incomplete sequence either
+		m_tokenizer.finish(ignore);
+	}
+	flush_pending(out);
+}
+
+}
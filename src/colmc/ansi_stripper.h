@@ -0,0 +1,68 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#ifndef colmc_ansi_stripper_h_INCLUDED
+#define colmc_ansi_stripper_h_INCLUDED
+
+#include <cstddef>
+#include <vector>
+#include <colmc/algorithms.h>
+#include <colmc/vt_tokenizer.h>
+
+namespace colmc {
+
+enum class strip_mode {
+	none, //!< output everything
+	sgr,  //!< remove SGR sequences (colors) and style tags, e.g. for NO_COLOR on a terminal
+	all   //!< remove all escape sequences, strings (like OSC) and style tags, e.g. for a file
+};
+
+//! \brief Copies text while removing escape sequences (and style tags if they are enabled).
+//! The sequences are taken by vt_tokenizer, so all kinds are removed (also private ones like
+//! ESC [ ? 25 l, the strings of OSC, DCS, ... and ESC sequences like ESC 7), just as a terminal
+//! doesn't show them; they may be split anywhere, whatever their length. The text between them
+//! is found by a single vectorized scan for ESC and '<' and copied in one piece. A style tag
+//! that is cut off at the end of one call of filter() is kept back and completed by the next call.
+class ansi_stripper {
+public:
+	ansi_stripper(strip_mode mode, bool style_tags)
+		:m_mode(mode)
+		,m_style_tags(style_tags)
+	{
+	}
+
+	void filter(const char* p, std::size_t n, std::vector<char>& out);
+
+	//! \brief Writes a kept back incomplete style tag to out (it is no tag after all); an
+	//! incomplete escape sequence is dropped unless the mode is strip_mode::none
+	void finish(std::vector<char>& out);
+
+	//! \brief Number of chars at the beginning of [p, p + n) that are copied as they are
+	std::size_t count_plain(const char* p, std::size_t n) const;
+
+	//! \brief Starts over with another output in the given mode (after finish(), to reuse the
+	//! buffers)
+	void reset(strip_mode mode) {
+		m_mode = mode;
+		m_tokenizer.reset();
+		m_pending_size = 0;
+	}
+
+	bool has_pending() const {
+		return (m_pending_size > 0u) || (!m_tokenizer.in_ground());
+	}
+
+private:
+	struct handler;
+
+	std::size_t take_tag(const char* p, std::size_t n, std::vector<char>& out);
+	void flush_pending(std::vector<char>& out);
+
+	strip_mode m_mode;
+	bool m_style_tags;
+	vt_tokenizer m_tokenizer;
+	char m_pending[max_style_seq_len]; // an incomplete style tag
+	std::size_t m_pending_size = 0;
+};
+
+}
+
+#endif
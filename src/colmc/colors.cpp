@@ -0,0 +1,231 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#include <cstdlib>
+#include <cstring>
+#include <colmc/colors.h>
+
+using namespace colmc;
+
+namespace {
+
+// The palette colors as xterm shows them
+constexpr std::uint8_t basic_palette[16][3] = {
+	{   0,   0,   0 }, { 205,   0,   0 }, {   0, 205,   0 }, { 205, 205,   0 },
+	{   0,   0, 238 }, { 205,   0, 205 }, {   0, 205, 205 }, { 229, 229, 229 },
+	{ 127, 127, 127 }, { 255,   0,   0 }, {   0, 255,   0 }, { 255, 255,   0 },
+	{  92,  92, 255 }, { 255,   0, 255 }, {   0, 255, 255 }, { 255, 255, 255 }
+};
+constexpr std::uint8_t cube_levels[6] = { 0, 95, 135, 175, 215, 255 };
+constexpr unsigned num_grays = 24u;
+constexpr unsigned first_gray = 232u;
+constexpr unsigned first_cube = 16u;
+
+constexpr std::uint8_t gray_level(unsigned i) {
+	return static_cast<std::uint8_t>(8u + (10u * i));
+}
+
+constexpr unsigned distance(unsigned r1, unsigned g1, unsigned b1, unsigned r2, unsigned g2, unsigned b2) {
+	const int dr = static_cast<int>(r1) - static_cast<int>(r2);
+	const int dg = static_cast<int>(g1) - static_cast<int>(g2);
+	const int db = static_cast<int>(b1) - static_cast<int>(b2);
+	return static_cast<unsigned>((dr * dr) + (dg * dg) + (db * db));
+}
+
+constexpr std::uint8_t nearest_basic(unsigned r, unsigned g, unsigned b) {
+	std::uint8_t best = 0;
+	unsigned best_distance = ~0u;
+	for (std::uint8_t i = 0; i < 16u; ++i) {
+		const unsigned d = distance(r, g, b, basic_palette[i][0], basic_palette[i][1], basic_palette[i][2]);
+		if (d < best_distance) {
+			best = i;
+			best_distance = d;
+		}
+	}
+	return best;
+}
+
+// All distance searches are done here, at compile time
+struct color_tables {
+	std::uint8_t palette[256][3] = {};  // color256 -> RGB
+	std::uint8_t cube_index[256] = {};  // channel value -> nearest of cube_levels
+	std::uint8_t gray_index[256] = {};  // channel value -> nearest gray of the ramp
+	std::uint8_t basic_of_palette[256] = {};
+};
+
+struct basic_rgb_table {
+	std::uint8_t basic[4096] = {}; // 4 bits per channel -> nearest basic color
+};
+
+constexpr color_tables make_color_tables() {
+	color_tables t;
+	for (unsigned i = 0; i < 16u; ++i) {
+		for (unsigned c = 0; c < 3u; ++c) {
+			t.palette[i][c] = basic_palette[i][c];
+		}
+	}
+	for (unsigned i = 0; i < 216u; ++i) {
+		t.palette[first_cube + i][0] = cube_levels[i / 36u];
+		t.palette[first_cube + i][1] = cube_levels[(i / 6u) % 6u];
+		t.palette[first_cube + i][2] = cube_levels[i % 6u];
+	}
+	for (unsigned i = 0; i < num_grays; ++i) {
+		for (unsigned c = 0; c < 3u; ++c) {
+			t.palette[first_gray + i][c] = gray_level(i);
+		}
+	}
+	for (unsigned v = 0; v < 256u; ++v) {
+		for (std::uint8_t i = 1; i < 6u; ++i) {
+			if ((v * 2u) >= (static_cast<unsigned>(cube_levels[i - 1u]) + cube_levels[i])) { // past the midpoint to the previous level
+				t.cube_index[v] = i;
+			}
+		}
+		const unsigned gray = (v < 8u) ? 0u : ((v - 3u) / 10u); // nearest of 8, 18, ..., 238
+		t.gray_index[v] = static_cast<std::uint8_t>((gray < num_grays) ? gray : (num_grays - 1u));
+	}
+	for (unsigned i = 0; i < 256u; ++i) {
+		t.basic_of_palette[i] = (i < 16u) ? static_cast<std::uint8_t>(i) : nearest_basic(t.palette[i][0], t.palette[i][1], t.palette[i][2]);
+	}
+	return t;
+}
+
+constexpr basic_rgb_table make_basic_rgb_table() {
+	basic_rgb_table t;
+	for (unsigned i = 0; i < 4096u; ++i) {
+		t.basic[i] = nearest_basic(((i >> 8u) << 4u) | 8u, (((i >> 4u) & 0x0Fu) << 4u) | 8u, ((i & 0x0Fu) << 4u) | 8u);
+	}
+	return t;
+}
+
+constexpr color_tables tables = make_color_tables();
+
+// 64k distances may exceed the constexpr step limit of some compilers, so this one is filled at
+// its first use, which may be from the static initializers of other translation units as well
+const basic_rgb_table& basic_of_rgb() {
+	static const basic_rgb_table table = make_basic_rgb_table();
+	return table;
+}
+
+static_assert(tables.cube_index[47] == 0 && tables.cube_index[48] == 1 && tables.cube_index[255] == 5, "cube levels");
+static_assert(tables.basic_of_palette[196] == 9, "pure red is the bright red");
+
+bool contains(const char* s, const char* part) {
+	return (s != nullptr) && (std::strstr(s, part) != nullptr);
+}
+
+char* write_color(char* out, unsigned selector, unsigned mode, const std::uint8_t* values, std::size_t n) {
+	*out++ = '\x1B';
+	*out++ = '[';
+	out = detail::write_number_constexpr(out, selector);
+	*out++ = ';';
+	out = detail::write_number_constexpr(out, mode);
+	for (std::size_t i = 0; i < n; ++i) {
+		*out++ = ';';
+		out = detail::write_number_constexpr(out, values[i]);
+	}
+	*out++ = 'm';
+	return out;
+}
+
+// ESC [ 3x m / ESC [ 9x m (bright) for the foreground, 4x / 10x for the background
+char* write_basic(char* out, std::uint8_t index, bool background) {
+	const unsigned base = (index < 8u) ? (background ? 40u : 30u) : (background ? 100u : 90u);
+	*out++ = '\x1B';
+	*out++ = '[';
+	out = detail::write_number_constexpr(out, base + (index & 7u));
+	*out++ = 'm';
+	return out;
+}
+
+char* write_rgb(char* out, rgb c, color_support support, bool background) {
+	switch (support) {
+		case color_support::none:
+			return out;
+		case color_support::basic:
+			return write_basic(out, to_ansi16(c), background);
+		case color_support::ansi256: {
+			const std::uint8_t index = to_ansi256(c);
+			return write_color(out, background ? 48u : 38u, 5u, &index, 1u);
+		}
+		case color_support::truecolor: {
+			const std::uint8_t values[3] = { c.r, c.g, c.b };
+			return write_color(out, background ? 48u : 38u, 2u, values, 3u);
+		}
+	}
+	return out;
+}
+
+char* write_palette(char* out, color256 c, color_support support, bool background) {
+	switch (support) {
+		case color_support::none:
+			return out;
+		case color_support::basic:
+			return write_basic(out, to_ansi16(c), background);
+		case color_support::ansi256:
+		case color_support::truecolor:
+			return write_color(out, background ? 48u : 38u, 5u, &c.index, 1u);
+	}
+	return out;
+}
+
+}
+
+namespace colmc {
+
+color_support detect_color_support(const char* colorterm, const char* term) {
+	if (contains(colorterm, "truecolor") || contains(colorterm, "24bit") || contains(term, "-direct")) {
+		return color_support::truecolor;
+	}
+	if ((term != nullptr) && (std::strcmp(term, "dumb") == 0)) {
+		return color_support::none;
+	}
+	if (contains(term, "256color")) {
+		return color_support::ansi256;
+	}
+	return color_support::basic;
+}
+
+color_support detect_color_support() {
+	return detect_color_support(std::getenv("COLORTERM"), std::getenv("TERM"));
+}
+
+std::uint8_t to_ansi256(rgb c) {
+	// the nearest cube color and the nearest gray, whichever is nearer
+	const unsigned ri = tables.cube_index[c.r];
+	const unsigned gi = tables.cube_index[c.g];
+	const unsigned bi = tables.cube_index[c.b];
+	const unsigned cube = first_cube + (36u * ri) + (6u * gi) + bi;
+	const unsigned gray = first_gray + tables.gray_index[(c.r + c.g + c.b) / 3u];
+	const unsigned cube_distance = distance(c.r, c.g, c.b, cube_levels[ri], cube_levels[gi], cube_levels[bi]);
+	const std::uint8_t level = tables.palette[gray][0];
+	const unsigned gray_distance = distance(c.r, c.g, c.b, level, level, level);
+	return static_cast<std::uint8_t>((gray_distance < cube_distance) ? gray : cube);
+}
+
+std::uint8_t to_ansi16(rgb c) {
+	return basic_of_rgb().basic[((c.r >> 4u) << 8u) | ((c.g >> 4u) << 4u) | (c.b >> 4u)];
+}
+
+std::uint8_t to_ansi16(color256 c) {
+	return tables.basic_of_palette[c.index];
+}
+
+rgb to_rgb(color256 c) {
+	return rgb{tables.palette[c.index][0], tables.palette[c.index][1], tables.palette[c.index][2]};
+}
+
+char* fore_color(char* out, rgb c, color_support support) {
+	return write_rgb(out, c, support, false);
+}
+
+char* back_color(char* out, rgb c, color_support support) {
+	return write_rgb(out, c, support, true);
+}
+
+char* fore_color(char* out, color256 c, color_support support) {
+	return write_palette(out, c, support, false);
+}
+
+char* back_color(char* out, color256 c, color_support support) {
+	return write_palette(out, c, support, true);
+}
+
+}
@@ -0,0 +1,178 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#include <cstring>
+#include <charconv>
+#include <colmc/cursor.h>
+
+using namespace colmc;
+
+namespace {
+
+// One way to move the cursor. Moves that don't fit are discarded.
+class motion {
+public:
+	void put(char c) {
+		if (m_len < max_motion_len) {
+			m_chars[m_len] = c;
+		}
+		++m_len;
+	}
+
+	void put(const char* p, std::size_t n) {
+		for (std::size_t i = 0; i < n; ++i) {
+			put(p[i]);
+		}
+	}
+
+	// ESC [ n <command>, the 1 is the default and can be omitted
+	void put_csi(unsigned n, char command) {
+		put('\x1B');
+		put('[');
+		if (n != 1u) {
+			put_number(n);
+		}
+		put(command);
+	}
+
+	void put_number(unsigned n) {
+		char digits[10];
+		const auto result = std::to_chars(digits, digits + sizeof(digits), n);
+		put(digits, static_cast<std::size_t>(result.ptr - digits));
+	}
+
+	std::size_t size() const {
+		return m_len;
+	}
+
+	bool fits() const {
+		return (m_len <= max_motion_len);
+	}
+
+	char* write(char* out) const {
+		std::memcpy(out, m_chars, m_len);
+		return out + m_len;
+	}
+
+private:
+	char m_chars[max_motion_len];
+	std::size_t m_len = 0;
+};
+
+void put_absolute(motion& m, int x, int y) {
+	m.put('\x1B');
+	m.put('[');
+	if ((x > 0) || (y > 0)) {
+		m.put_number(static_cast<unsigned>(y) + 1u);
+		if (x > 0) {
+			m.put(';');
+			m.put_number(static_cast<unsigned>(x) + 1u);
+		}
+	}
+	m.put('H');
+}
+
+// horizontal move within the row
+void put_horizontal(motion& m, int from_x, int x) {
+	if (x > from_x) {
+		m.put_csi(static_cast<unsigned>(x - from_x), 'C');
+	}
+	else if (x < from_x) {
+		const int n = from_x - x;
+		if (n <= 3) { // ESC [ n D takes 4 for n > 1
+			for (int i = 0; i < n; ++i) {
+				m.put('\b');
+			}
+		}
+		else {
+			m.put_csi(static_cast<unsigned>(n), 'D');
+		}
+	}
+}
+
+// to the beginning of the row and then forward
+void put_carriage_return(motion& m, int x) {
+	m.put('\r');
+	if (x > 0) {
+		m.put_csi(static_cast<unsigned>(x), 'C');
+	}
+}
+
+void take_if_shorter(motion& best, const motion& candidate) {
+	if (candidate.fits() && (candidate.size() < best.size())) {
+		best = candidate;
+	}
+}
+
+}
+
+namespace colmc {
+
+void cursor_planner::set_position(int x, int y) {
+	if ((x < 0) || (y < 0)) {
+		invalidate();
+		return;
+	}
+	m_x = x;
+	m_y = y;
+}
+
+char* cursor_planner::move_to(char* out, int x, int y, const char* overwrite, std::size_t overwrite_len) {
+	if ((x < 0) || (y < 0)) {
+		return out;
+	}
+	motion best;
+	put_absolute(best, x, y);
+	if (known() && ((x != m_x) || (y != m_y))) {
+		motion relative; // vertical, keeping the column
+		if (y > m_y) {
+			relative.put_csi(static_cast<unsigned>(y - m_y), 'B');
+		}
+		else if (y < m_y) {
+			relative.put_csi(static_cast<unsigned>(m_y - y), 'A');
+		}
+		put_horizontal(relative, m_x, x);
+		take_if_shorter(best, relative);
+
+		if ((overwrite != nullptr) && (y == m_y) && (x > m_x)) {
+			motion overwritten;
+			overwritten.put(overwrite, overwrite_len);
+			take_if_shorter(best, overwritten);
+		}
+
+		motion carriage_return; // CR (and LF for each row down, which doesn't scroll below the last row)
+		if (y > m_y) {
+			for (int i = m_y; i < y; ++i) {
+				carriage_return.put('\r');
+				carriage_return.put('\n');
+			}
+			if (x > 0) {
+				carriage_return.put_csi(static_cast<unsigned>(x), 'C');
+			}
+		}
+		else if (y < m_y) {
+			carriage_return.put_csi(static_cast<unsigned>(m_y - y), 'A');
+			put_carriage_return(carriage_return, x);
+		}
+		else {
+			put_carriage_return(carriage_return, x);
+		}
+		take_if_shorter(best, carriage_return);
+	}
+	else if (known()) {
+		best = motion{}; // already there
+	}
+	m_x = x;
+	m_y = y;
+	return best.write(out);
+}
+
+void cursor_planner::advance(int num_columns, int screen_columns) {
+	if (!known()) {
+		return;
+	}
+	m_x += num_columns;
+	if (m_x >= screen_columns) {
+		invalidate();
+	}
+}
+
+}
@@ -0,0 +1,81 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#ifndef colmc_input_buffer_h_INCLUDED
+#define colmc_input_buffer_h_INCLUDED
+
+#include <cstddef>
+
+namespace colmc {
+
+//! \brief Ring buffer for the raw bytes read from the terminal. It is filled by one read
+//! per burst of input (see free_ranges() and commit()), the keys are decoded from memory.
+class input_buffer {
+public:
+	static constexpr std::size_t capacity = 4096u; // power of two
+
+	std::size_t size() const {
+		return (m_end - m_begin);
+	}
+
+	bool empty() const {
+		return (m_end == m_begin);
+	}
+
+	std::size_t free() const {
+		return (capacity - size());
+	}
+
+	//! \brief i-th unread byte; i has to be less than size()
+	char operator[](std::size_t i) const {
+		return m_data[(m_begin + i) & mask];
+	}
+
+	//! \brief Returns the number of unread bytes that are contiguous in memory, starting at p
+	std::size_t readable(const char*& p) const {
+		const std::size_t begin = m_begin & mask;
+		p = m_data + begin;
+		return ((capacity - begin) < size()) ? (capacity - begin) : size();
+	}
+
+	void consume(std::size_t n) {
+		m_begin += n;
+	}
+
+	void clear() {
+		m_begin = m_end = 0;
+	}
+
+	//! \brief Returns the free space as (up to) two contiguous ranges; the number of ranges is returned
+	std::size_t free_ranges(char* (&p)[2], std::size_t (&n)[2]) {
+		const std::size_t num_free = free();
+		if (num_free == 0) {
+			return 0;
+		}
+		const std::size_t end = m_end & mask;
+		const std::size_t first = (capacity - end < num_free) ? (capacity - end) : num_free;
+		p[0] = m_data + end;
+		n[0] = first;
+		if (first == num_free) {
+			return 1u;
+		}
+		p[1] = m_data;
+		n[1] = num_free - first;
+		return 2u;
+	}
+
+	//! \brief n bytes have been written to the ranges returned by free_ranges()
+	void commit(std::size_t n) {
+		m_end += n;
+	}
+
+private:
+	static constexpr std::size_t mask = capacity - 1u;
+	static_assert((capacity & mask) == 0, "capacity has to be a power of two");
+
+	char m_data[capacity];
+	std::size_t m_begin = 0; // only growing; wrapping around is fine as the capacity is a power of two
+	std::size_t m_end = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,411 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#include <cstring>
+#include <colmc/key_decoder.h>
+
+using namespace colmc;
+
+namespace {
+
+constexpr unsigned char esc = 0x1B;
+constexpr unsigned max_param_value = 9999u;
+constexpr unsigned paste_begin = 200u; // ESC [ 200 ~
+constexpr char paste_end[] = "\x1B[201~";
+constexpr std::size_t paste_end_len = sizeof(paste_end) - 1u;
+
+struct key_table {
+	key_enum keys[128] = {}; // key_enum::no_key_pressed: not in the table
+};
+
+// final byte of ESC [ <modifiers> <final> and ESC O <final>
+constexpr key_table make_letter_table() {
+	key_table t;
+	t.keys['A'] = key_enum::up;
+	t.keys['B'] = key_enum::down;
+	t.keys['C'] = key_enum::right;
+	t.keys['D'] = key_enum::left;
+	t.keys['E'] = key_enum::begin;
+	t.keys['F'] = key_enum::end;
+	t.keys['H'] = key_enum::home;
+	t.keys['P'] = key_enum::f1;
+	t.keys['Q'] = key_enum::f2;
+	t.keys['R'] = key_enum::f3;
+	t.keys['S'] = key_enum::f4;
+	return t;
+}
+
+// number of ESC [ <number> ; <modifiers> ~ (VT220 style)
+constexpr key_table make_tilde_table() {
+	key_table t;
+	t.keys[1]  = key_enum::home;
+	t.keys[2]  = key_enum::insert;
+	t.keys[3]  = key_enum::del;
+	t.keys[4]  = key_enum::end;
+	t.keys[5]  = key_enum::page_up;
+	t.keys[6]  = key_enum::page_down;
+	t.keys[7]  = key_enum::home;
+	t.keys[8]  = key_enum::end;
+	t.keys[11] = key_enum::f1;
+	t.keys[12] = key_enum::f2;
+	t.keys[13] = key_enum::f3;
+	t.keys[14] = key_enum::f4;
+	t.keys[15] = key_enum::f5;
+	t.keys[17] = key_enum::f6;
+	t.keys[18] = key_enum::f7;
+	t.keys[19] = key_enum::f8;
+	t.keys[20] = key_enum::f9;
+	t.keys[21] = key_enum::f10;
+	t.keys[23] = key_enum::f11;
+	t.keys[24] = key_enum::f12;
+	return t;
+}
+
+// final byte of ESC [ [ <final> (Linux console)
+constexpr key_table make_linux_table() {
+	key_table t;
+	t.keys['A'] = key_enum::f1;
+	t.keys['B'] = key_enum::f2;
+	t.keys['C'] = key_enum::f3;
+	t.keys['D'] = key_enum::f4;
+	t.keys['E'] = key_enum::f5;
+	return t;
+}
+
+constexpr key_table letter_keys = make_letter_table();
+constexpr key_table tilde_keys = make_tilde_table();
+constexpr key_table linux_keys = make_linux_table();
+
+key_enum lookup(const key_table& table, unsigned index) {
+	if ((index >= 128u) || (table.keys[index] == key_enum::no_key_pressed)) {
+		return key_enum::unknown;
+	}
+	return table.keys[index];
+}
+
+void set_special(key& k, key_enum e, std::uint8_t modifiers) {
+	k = key{};
+	k.special = e;
+	k.modifiers = (e == key_enum::unknown) ? modifier::none : modifiers;
+}
+
+void set_regular(key& k, const char* bytes, std::size_t n, std::uint8_t modifiers) {
+	k = key{};
+	k.special = key_enum::regular;
+	for (std::size_t i = 0; (i < n) && (i < (sizeof(k.regular.bytes) - 1u)); ++i) { // keeps the null terminator
+		k.regular.bytes[i] = bytes[i];
+	}
+	k.modifiers = modifiers;
+}
+
+bool is_final_byte(unsigned char c) {
+	return ((c >= 0x40) && (c <= 0x7E));
+}
+
+// Button numbers of the SGR mouse protocol (bits 0, 1, 6 and 7 of the first parameter)
+constexpr mouse_button mouse_buttons[16] = {
+	mouse_button::left,     mouse_button::middle,     mouse_button::right,      mouse_button::none,
+	mouse_button::wheel_up, mouse_button::wheel_down, mouse_button::wheel_left, mouse_button::wheel_right,
+	mouse_button::back,     mouse_button::forward,    mouse_button::other,      mouse_button::other,
+	mouse_button::other,    mouse_button::other,      mouse_button::other,      mouse_button::other
+};
+
+// ESC [ < <button> ; <x> ; <y> M (m: release), with x and y being 1-based
+void set_mouse(key& k, const unsigned* params, bool release, std::uint8_t modifiers) {
+	const unsigned b = params[0];
+	k = key{};
+	k.special = key_enum::mouse;
+	k.mouse.button = mouse_buttons[(b & 0x03u) | ((b >> 4u) & 0x0Cu)];
+	if (release) {
+		k.mouse.action = mouse_action::release;
+	}
+	else if ((b & 0x20u) != 0) {
+		k.mouse.action = mouse_action::move;
+	}
+	k.mouse.x = static_cast<std::uint16_t>((params[1] > 0) ? (params[1] - 1u) : 0u);
+	k.mouse.y = static_cast<std::uint16_t>((params[2] > 0) ? (params[2] - 1u) : 0u);
+	k.modifiers = modifiers;
+	if ((b & 0x04u) != 0) {
+		k.modifiers |= modifier::shift;
+	}
+	if ((b & 0x08u) != 0) {
+		k.modifiers |= modifier::alt;
+	}
+	if ((b & 0x10u) != 0) {
+		k.modifiers |= modifier::ctrl;
+	}
+}
+
+}
+
+namespace colmc {
+
+bool key_decoder::feed(char ch, key& k) {
+	const auto c = static_cast<unsigned char>(ch);
+	switch (m_state) {
+		case state::ground: return feed_ground(c, k);
+		case state::esc:    return feed_esc(c, k);
+		case state::csi:    return feed_csi(c, k);
+		case state::ss3:    return feed_ss3(c, k);
+		case state::utf8:   return feed_utf8(c, k);
+		case state::paste:  return feed_paste(c, k);
+	}
+	return false;
+}
+
+bool key_decoder::flush(key& k) {
+	const char esc_char = static_cast<char>(esc);
+	switch (m_state) {
+		case state::ground:
+			return false;
+		case state::esc: // the ESC key (pressed with ALT if there were two)
+			set_regular(k, &esc_char, 1u, m_alt ? modifier::alt : modifier::none);
+			break;
+		case state::csi:
+		case state::ss3:
+			if ((m_num_params == 0) && (m_private == '\0')) { // ALT+[ and ALT+O look like the start of a sequence
+				const char c = (m_state == state::csi) ? '[' : 'O';
+				set_regular(k, &c, 1u, modifier::alt);
+			}
+			else {
+				set_special(k, key_enum::unknown, modifier::none);
+			}
+			break;
+		case state::utf8:
+			set_special(k, key_enum::unknown, modifier::none);
+			break;
+		case state::paste:
+			return false;
+	}
+	m_state = state::ground;
+	return true;
+}
+
+bool key_decoder::feed_ground(unsigned char c, key& k) {
+	m_alt = false;
+	if (c == esc) {
+		m_state = state::esc;
+		return false;
+	}
+	if (c < 0x80) {
+		const char ch = static_cast<char>(c);
+		set_regular(k, &ch, 1u, modifier::none);
+		return true;
+	}
+	if ((c >= 0xC0) && (c <= 0xF7)) {
+		start_utf8(c);
+		return false;
+	}
+	set_special(k, key_enum::unknown, modifier::none); // not the start of a UTF-8 char
+	return true;
+}
+
+bool key_decoder::feed_esc(unsigned char c, key& k) {
+	if (c == '[') {
+		start_sequence(state::csi);
+		return false;
+	}
+	if (c == 'O') {
+		start_sequence(state::ss3);
+		return false;
+	}
+	if (c == esc) {
+		if (!m_alt) { // ESC ESC: ALT+ESC or ALT plus a sequence
+			m_alt = true;
+			return false;
+		}
+		const char esc_char = static_cast<char>(esc);
+		set_regular(k, &esc_char, 1u, modifier::alt); // the third ESC starts over
+		m_alt = false;
+		return true;
+	}
+	if (c < 0x80) { // ALT+key
+		const char ch = static_cast<char>(c);
+		set_regular(k, &ch, 1u, modifier::alt);
+		m_state = state::ground;
+		return true;
+	}
+	if ((c >= 0xC0) && (c <= 0xF7)) {
+		m_alt = true;
+		start_utf8(c);
+		return false;
+	}
+	set_special(k, key_enum::unknown, modifier::none);
+	m_state = state::ground;
+	return true;
+}
+
+void key_decoder::start_sequence(state s) {
+	m_state = s;
+	m_private = '\0';
+	m_num_params = 0;
+	for (auto& param : m_params) {
+		param = 0;
+	}
+}
+
+bool key_decoder::feed_csi(unsigned char c, key& k) {
+	if ((c >= '0') && (c <= '9')) {
+		if (m_num_params == 0) {
+			m_num_params = 1u;
+		}
+		if (m_num_params <= max_params) {
+			unsigned& param = m_params[m_num_params - 1u];
+			param = (param * 10u) + (c - '0');
+			if (param > max_param_value) {
+				param = max_param_value;
+			}
+		}
+		return false;
+	}
+	if ((c == ';') || (c == ':')) {
+		if (m_num_params == 0) {
+			m_num_params = 1u; // empty first parameter
+		}
+		if (m_num_params <= max_params) {
+			++m_num_params; // beyond max_params the parameters are ignored
+		}
+		return false;
+	}
+	if ((m_num_params == 0) && (m_private == '\0') && (((c >= 0x3C) && (c <= 0x3F)) || (c == '['))) {
+		m_private = static_cast<char>(c);
+		return false;
+	}
+	if ((c >= 0x20) && (c <= 0x3F)) { // intermediate bytes and misplaced parameter bytes
+		return false;
+	}
+	if ((c == '~') && (m_private == '\0') && (m_num_params == 1u) && (m_params[0] == paste_begin)) {
+		m_state = state::paste;
+		m_paste.clear(); // keeps the capacity
+		m_paste_end_matched = 0;
+		return false;
+	}
+	if (is_final_byte(c)) {
+		finish_csi(c, k);
+		m_state = state::ground;
+		return true;
+	}
+	// a control char interrupts the sequence
+	set_special(k, key_enum::unknown, modifier::none);
+	m_state = (c == esc) ? state::esc : state::ground;
+	m_alt = false;
+	return true;
+}
+
+std::uint8_t key_decoder::modifiers_param() const {
+	std::uint8_t result = m_alt ? modifier::alt : modifier::none;
+	if ((m_num_params >= 2u) && (m_params[1] >= 2u)) {
+		result |= static_cast<std::uint8_t>((m_params[1] - 1u) & 0x0Fu);
+	}
+	return result;
+}
+
+void key_decoder::finish_csi(unsigned char final_byte, key& k) {
+	if (m_private == '[') {
+		set_special(k, lookup(linux_keys, final_byte), m_alt ? modifier::alt : modifier::none);
+		return;
+	}
+	if ((m_private == '<') && ((final_byte == 'M') || (final_byte == 'm')) && (m_num_params == 3u)) {
+		set_mouse(k, m_params, final_byte == 'm', m_alt ? modifier::alt : modifier::none);
+		return;
+	}
+	if (m_private != '\0') {
+		set_special(k, key_enum::unknown, modifier::none);
+		return;
+	}
+	if (final_byte == '~') {
+		const unsigned number = (m_num_params == 0) ? 1u : m_params[0];
+		set_special(k, lookup(tilde_keys, number), modifiers_param());
+		return;
+	}
+	if (final_byte == 'Z') { // SHIFT+TAB
+		const char tab = '\t';
+		set_regular(k, &tab, 1u, static_cast<std::uint8_t>(modifiers_param() | modifier::shift));
+		return;
+	}
+	set_special(k, lookup(letter_keys, final_byte), modifiers_param());
+}
+
+bool key_decoder::feed_ss3(unsigned char c, key& k) {
+	if ((c >= '0') && (c <= '9')) { // some terminals send the modifiers like ESC O 5 A
+		m_num_params = 2u;
+		m_params[1] = (m_params[1] * 10u) + (c - '0');
+		if (m_params[1] > max_param_value) {
+			m_params[1] = max_param_value;
+		}
+		return false;
+	}
+	if (is_final_byte(c)) {
+		set_special(k, lookup(letter_keys, c), modifiers_param());
+		m_state = state::ground;
+		return true;
+	}
+	set_special(k, key_enum::unknown, modifier::none);
+	m_state = (c == esc) ? state::esc : state::ground;
+	m_alt = false;
+	return true;
+}
+
+void key_decoder::start_utf8(unsigned char c) {
+	m_state = state::utf8;
+	m_utf8[0] = static_cast<char>(c);
+	m_utf8_len = 1u;
+	if ((c & 0xE0) == 0xC0) {
+		m_utf8_needed = 2u;
+	}
+	else if ((c & 0xF0) == 0xE0) {
+		m_utf8_needed = 3u;
+	}
+	else {
+		m_utf8_needed = 4u;
+	}
+}
+
+bool key_decoder::feed_utf8(unsigned char c, key& k) {
+	if ((c & 0xC0) != 0x80) { // not a continuation byte
+		set_special(k, key_enum::unknown, modifier::none);
+		m_state = (c == esc) ? state::esc : state::ground;
+		m_alt = false;
+		return true;
+	}
+	m_utf8[m_utf8_len++] = static_cast<char>(c);
+	if (m_utf8_len < m_utf8_needed) {
+		return false;
+	}
+	set_regular(k, m_utf8, m_utf8_len, m_alt ? modifier::alt : modifier::none);
+	m_state = state::ground;
+	return true;
+}
+
+bool key_decoder::feed_paste(unsigned char c, key& k) {
+	const char ch = static_cast<char>(c);
+	if (ch == paste_end[m_paste_end_matched]) {
+		++m_paste_end_matched;
+		if (m_paste_end_matched < paste_end_len) {
+			return false;
+		}
+		set_special(k, key_enum::paste, modifier::none);
+		m_state = state::ground;
+		return true;
+	}
+	if (m_paste_end_matched > 0) { // wasn't the end after all
+		m_paste.append(paste_end, m_paste_end_matched);
+		m_paste_end_matched = 0;
+		if (ch == paste_end[0]) {
+			m_paste_end_matched = 1u;
+			return false;
+		}
+	}
+	m_paste += ch;
+	return false;
+}
+
+std::size_t key_decoder::feed_paste(const char* p, std::size_t n) {
+	if ((m_state != state::paste) || (m_paste_end_matched > 0)) {
+		return 0;
+	}
+	const void* esc_pos = std::memchr(p, static_cast<int>(esc), n);
+	const std::size_t len = (esc_pos == nullptr) ? n : static_cast<std::size_t>(static_cast<const char*>(esc_pos) - p);
+	m_paste.append(p, len);
+	return len;
+}
+
+}
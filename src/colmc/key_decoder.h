@@ -0,0 +1,90 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#ifndef colmc_key_decoder_h_INCLUDED
+#define colmc_key_decoder_h_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <colmc/raw_input.h>
+
+namespace colmc {
+
+//! \brief Turns the bytes sent by a terminal into keys: UTF-8 chars, ALT+key (ESC prefix) and
+//! the xterm/VT220 escape sequences (CSI and SS3 forms, with modifiers) and SGR (1006) mouse
+//! reports. It is a state machine with a constant amount of work per byte, so sequences may be
+//! split anywhere. Unknown sequences are consumed completely and returned as key_enum::unknown.
+class key_decoder {
+public:
+	//! \brief Feeds the next byte of input.
+	//! \returns true if k has been set to a complete key
+	bool feed(char c, key& k);
+
+	//! \brief To be called when no more input is coming (for now). Completes a pending ESC
+	//! (the ESC key itself) or an incomplete sequence.
+	//! \returns true if k has been set
+	bool flush(key& k);
+
+	//! \brief true if bytes of an incomplete key have been fed
+	bool pending() const {
+		return (m_state != state::ground);
+	}
+
+	//! \brief true if more than just an ESC is pending, i.e. the rest of a sequence is
+	//! very likely on its way
+	bool in_sequence() const {
+		return ((m_state != state::ground) && (m_state != state::esc));
+	}
+
+	//! \brief true within bracketed paste (ESC [ 200 ~ ... ESC [ 201 ~). flush() doesn't
+	//! end it, as the rest of the pasted text may take a while.
+	bool in_paste() const {
+		return (m_state == state::paste);
+	}
+
+	//! \brief Within a paste: takes the pasted text up to the next ESC at once.
+	//! \returns the number of bytes taken
+	std::size_t feed_paste(const char* p, std::size_t n);
+
+	//! \brief The text of the last key_enum::paste. The buffer is reused by the next paste.
+	std::string& pasted_text() {
+		return m_paste;
+	}
+
+private:
+	enum class state: std::uint8_t {
+		ground,
+		esc,   // after ESC
+		csi,   // after ESC [
+		ss3,   // after ESC O
+		utf8,  // within a multi-byte UTF-8 char
+		paste  // within bracketed paste
+	};
+
+	static constexpr std::size_t max_params = 4u;
+
+	bool feed_ground(unsigned char c, key& k);
+	bool feed_esc(unsigned char c, key& k);
+	bool feed_csi(unsigned char c, key& k);
+	bool feed_ss3(unsigned char c, key& k);
+	bool feed_utf8(unsigned char c, key& k);
+	bool feed_paste(unsigned char c, key& k);
+	void start_utf8(unsigned char c);
+	void start_sequence(state s);
+	void finish_csi(unsigned char final_byte, key& k);
+	std::uint8_t modifiers_param() const;
+
+	state m_state = state::ground;
+	bool m_alt = false;           // ESC prefix
+	char m_private = '\0';        // private marker after CSI, like '<' or '?'
+	unsigned m_params[max_params] = {};
+	std::size_t m_num_params = 0;
+	char m_utf8[4] = {};
+	std::size_t m_utf8_len = 0;
+	std::size_t m_utf8_needed = 0;
+	std::string m_paste;
+	std::size_t m_paste_end_matched = 0; // chars of ESC [ 2 0 1 ~ seen within a paste
+};
+
+}
+
+#endif
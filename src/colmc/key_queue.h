@@ -0,0 +1,71 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#ifndef colmc_key_queue_h_INCLUDED
+#define colmc_key_queue_h_INCLUDED
+
+#include <cstddef>
+#include <atomic>
+#include <utility>
+#include <colmc/raw_input.h>
+
+namespace colmc {
+
+//! \brief Bounded lock-free queue for exactly one producer thread (push(), full()) and one
+//! consumer thread (pop(), empty())
+template<typename T, std::size_t Capacity>
+class spsc_queue {
+public:
+	static constexpr std::size_t capacity = Capacity; // power of two
+
+	//! \brief Producer only. Returns false if the queue is full.
+	bool push(T item) {
+		const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+		if ((tail - m_head.load(std::memory_order_acquire)) == capacity) {
+			return false;
+		}
+		m_items[tail & mask] = std::move(item);
+		m_tail.store(tail + 1u, std::memory_order_release);
+		return true;
+	}
+
+	//! \brief Producer only
+	bool full() const {
+		return ((m_tail.load(std::memory_order_relaxed) - m_head.load(std::memory_order_acquire)) == capacity);
+	}
+
+	//! \brief Consumer only. Moves up to max_items items to items and returns their number.
+	std::size_t pop(T* items, std::size_t max_items) {
+		const std::size_t head = m_head.load(std::memory_order_relaxed);
+		const std::size_t available = m_tail.load(std::memory_order_acquire) - head;
+		const std::size_t n = (available < max_items) ? available : max_items;
+		for (std::size_t i = 0; i < n; ++i) {
+			items[i] = std::move(m_items[(head + i) & mask]);
+		}
+		m_head.store(head + n, std::memory_order_release);
+		return n;
+	}
+
+	//! \brief Consumer only
+	bool empty() const {
+		return (m_tail.load(std::memory_order_acquire) == m_head.load(std::memory_order_relaxed));
+	}
+
+	//! \brief Neither producer nor consumer may be active
+	void clear() {
+		m_head.store(0);
+		m_tail.store(0);
+	}
+
+private:
+	static constexpr std::size_t mask = capacity - 1u;
+	static_assert((capacity & mask) == 0, "capacity has to be a power of two");
+
+	T m_items[capacity];
+	alignas(64) std::atomic<std::size_t> m_head{0}; // written by the consumer; own cache line to avoid false sharing
+	alignas(64) std::atomic<std::size_t> m_tail{0}; // written by the producer
+};
+
+using key_queue = spsc_queue<key, 256u>;
+
+}
+
+#endif
@@ -0,0 +1,143 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#include <cstring>
+#include <streambuf>
+#include <vector>
+#include <colmc/log_sink.h>
+#include <colmc/algorithms.h>
+#include <colmc/styles.h>
+#include <colmc/output.h>
+
+using namespace colmc;
+
+namespace {
+
+constexpr char reset_sequence[] = "\x1B[0m";
+constexpr std::size_t reset_sequence_len = sizeof(reset_sequence) - 1u;
+
+// appends everything to a std::string
+class line_buffer : public std::basic_streambuf<char>
+{
+public:
+	std::string text;
+
+protected:
+	int_type overflow(int_type ch = std::char_traits<char>::eof()) override {
+		if (ch != std::char_traits<char>::eof()) {
+			text += static_cast<char>(ch);
+		}
+		return std::char_traits<char>::not_eof(ch);
+	}
+
+	std::streamsize xsputn(const char* p, std::streamsize n) override {
+		text.append(p, static_cast<std::size_t>(n));
+		return n;
+	}
+};
+
+}
+
+namespace colmc {
+
+// Per thread state, reused by all lines of the thread to avoid allocations
+struct log_sink::formatter {
+	line_buffer buf;
+	std::ostream stream{&buf};
+	style_stack styles; // of the line
+	std::string out;
+	std::vector<char> stripped; // see config::strip_sequences
+	ansi_stripper stripper{strip_mode::all, true}; // reset for each line
+	bool in_use = false;
+};
+
+log_sink::formatter& log_sink::thread_formatter() {
+	thread_local formatter f;
+	return f;
+}
+
+log_sink::log_line::log_line(log_sink& sink)
+	:m_sink(&sink)
+	,m_formatter(&thread_formatter())
+{
+	if (m_formatter->in_use) {
+		m_own_formatter = std::make_unique<formatter>();
+		m_formatter = m_own_formatter.get();
+	}
+	m_formatter->in_use = true;
+	m_formatter->buf.text.clear(); // keeps the capacity
+	m_formatter->stream.clear();
+	m_stream = &m_formatter->stream;
+}
+
+log_sink::log_line::log_line(log_line&& other) noexcept
+	:m_sink(other.m_sink)
+	,m_formatter(other.m_formatter)
+	,m_own_formatter(std::move(other.m_own_formatter))
+	,m_stream(other.m_stream)
+{
+	other.m_sink = nullptr;
+}
+
+log_sink::log_line::~log_line() {
+	if (m_sink == nullptr) { // moved from
+		return;
+	}
+	try {
+		const std::string& text = m_formatter->buf.text;
+		m_sink->write_line(*m_formatter, text.data(), text.size());
+	}
+	catch (...) { // a log line must not take the program down
+	}
+	m_formatter->in_use = false;
+}
+
+void log_sink::write_line(const char* p, std::size_t n) {
+	write_line(thread_formatter(), p, n); // only out, styles, stripped and stripper are used
+}
+
+void log_sink::write_line(formatter& f, const char* p, std::size_t n) {
+	if ((n > 0) && (p[n - 1] == '\n')) {
+		--n; // the reset sequence goes before it
+	}
+	const strip_mode strip = output_strip_mode(m_fd);
+	if (strip != strip_mode::none) {
+		f.stripper.reset(strip);
+		f.stripped.clear(); // keeps the capacity
+		f.stripper.filter(p, n, f.stripped);
+		f.stripper.finish(f.stripped);
+		f.stripped.push_back('\n');
+		write_atomically(m_fd, f.stripped.data(), f.stripped.size());
+		return;
+	}
+	f.out.clear(); // keeps the capacity
+	f.styles.clear();
+	const style_snapshot_guard guard; // the sequences are only copied to f.out
+	while (n > 0) {
+		const std::size_t pos = count_until(p, n, '<');
+		f.out.append(p, pos);
+		p += pos;
+		n -= pos;
+		if (n == 0) {
+			break;
+		}
+		const std::size_t end = find_end_of_style_sequence(p, n);
+		if (end != invalid_end_of_sequence) {
+			f.out += resolve_style_tag(guard.styles(), p, end, f.styles);
+			p += end;
+			n -= end;
+		}
+		else { // a regular '<' inside text
+			f.out += *p;
+			++p;
+			--n;
+		}
+	}
+	const bool ends_with_reset = (f.out.size() >= reset_sequence_len) &&
+	                             (std::memcmp(f.out.data() + f.out.size() - reset_sequence_len, reset_sequence, reset_sequence_len) == 0);
+	if ((!ends_with_reset) && (count_until_esc(f.out.data(), f.out.size()) < f.out.size())) { // the style may have changed
+		f.out.append(reset_sequence, reset_sequence_len);
+	}
+	f.out += '\n';
+	write_atomically(m_fd, f.out.data(), f.out.size());
+}
+
+}
@@ -0,0 +1,22 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#ifndef colmc_output_h_INCLUDED
+#define colmc_output_h_INCLUDED
+
+#include <cstddef>
+#include <colmc/ansi_stripper.h>
+
+// Output functions implemented by the platform specific setup.cpp for the platform
+// independent parts.
+
+namespace colmc {
+
+//! \brief Writes [p, p + n) to fd (1: stdout, 2: stderr) in one piece, so that it doesn't get
+//! mixed with the output of other threads calling this function. See log_sink for the details.
+void write_atomically(int fd, const char* p, std::size_t n);
+
+//! \brief What is removed from the output to fd (see config::strip_sequences)
+strip_mode output_strip_mode(int fd);
+
+}
+
+#endif
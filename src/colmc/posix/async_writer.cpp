@@ -0,0 +1,91 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#if defined(__unix__) || defined(__linux__) || (defined(__APPLE__) && defined(__MACH__))
+
+#include <cstring>
+#include <algorithm>
+#include <colmc/posix/async_writer.h>
+#include <colmc/posix/io.h>
+
+namespace colmc {
+
+async_writer::async_writer(int fd, std::chrono::milliseconds interval, std::size_t capacity)
+	:m_fd(fd)
+	,m_interval(interval)
+	,m_ring(capacity, '\0')
+{
+	m_thread = std::thread{[this]() { run(); }};
+}
+
+async_writer::~async_writer() {
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		m_stop = true;
+	}
+	m_data_available.notify_one();
+	m_thread.join();
+}
+
+void async_writer::write(const char* p, std::size_t n) {
+	std::unique_lock<std::mutex> lock{m_mutex};
+	while (n > 0) {
+		const std::size_t piece = std::min(n, m_ring.size());
+		if (m_ring.size() - size() < piece) {
+			m_flush_target = m_appended; // don't let the writer wait for the interval
+			m_data_available.notify_one();
+			m_data_written.wait(lock, [this, piece]() { return (m_ring.size() - size() >= piece); });
+		}
+		const bool was_empty = (size() == 0);
+		append(p, piece);
+		p += piece;
+		n -= piece;
+		if (was_empty || (size() >= high_watermark)) {
+			m_data_available.notify_one();
+		}
+	}
+}
+
+void async_writer::append(const char* p, std::size_t n) {
+	const std::size_t pos = static_cast<std::size_t>(m_appended % m_ring.size());
+	const std::size_t first = std::min(n, m_ring.size() - pos);
+	std::memcpy(m_ring.data() + pos, p, first);
+	std::memcpy(m_ring.data(), p + first, n - first);
+	m_appended += n;
+}
+
+void async_writer::flush_and_wait() {
+	std::unique_lock<std::mutex> lock{m_mutex};
+	const std::uint64_t target = m_appended;
+	if (m_written >= target) {
+		return;
+	}
+	m_flush_target = std::max(m_flush_target, target);
+	m_data_available.notify_one();
+	m_data_written.wait(lock, [this, target]() { return (m_written >= target); });
+}
+
+void async_writer::run() {
+	std::unique_lock<std::mutex> lock{m_mutex};
+	for (;;) {
+		m_data_available.wait(lock, [this]() { return (m_stop || (size() > 0)); });
+		if (size() == 0) { // stopped and everything written
+			break;
+		}
+		// collect output for a while, so that many small writes cost only one syscall
+		m_data_available.wait_for(lock, m_interval, [this]() {
+			return (m_stop || (m_flush_target > m_written) || (size() >= high_watermark));
+		});
+		const std::size_t n = size();
+		const std::size_t pos = static_cast<std::size_t>(m_written % m_ring.size());
+		const std::size_t first = std::min(n, m_ring.size() - pos);
+		iovec parts[2] = { { m_ring.data() + pos, first }, { m_ring.data(), n - first } };
+		lock.unlock(); // the written part of the ring isn't touched by write()
+		writev_all(m_fd, parts, (n > first) ? 2u : 1u);
+		lock.lock();
+		m_written += n;
+		m_data_written.notify_all();
+	}
+}
+
+}
+
+#endif
@@ -0,0 +1,60 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#ifndef colmc_async_writer_h_INCLUDED
+#define colmc_async_writer_h_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+namespace colmc {
+
+//! \brief Decouples the writing threads from the speed of the terminal (config::async_output).
+//! write() copies into a ring buffer; a writer thread collects the output for up to the given
+//! interval and drains the ring with writev() (both parts at once if it wraps). Only when the
+//! ring is full, write() waits for the terminal.
+class async_writer {
+public:
+	async_writer(int fd, std::chrono::milliseconds interval, std::size_t capacity = default_capacity);
+	async_writer(const async_writer&) = delete;
+	async_writer& operator=(const async_writer&) = delete;
+
+	//! \brief Writes everything that is still buffered
+	~async_writer();
+
+	//! \brief Appends [p, p + n). Data of up to the capacity is appended in one piece, so it
+	//! isn't mixed with the data of concurrent calls.
+	void write(const char* p, std::size_t n);
+
+	//! \brief Returns when everything appended before has been written to the fd
+	void flush_and_wait();
+
+private:
+	static constexpr std::size_t default_capacity = 1024u * 1024u;
+	static constexpr std::size_t high_watermark = 64u * 1024u; // written without waiting for the interval
+
+	void run();
+	void append(const char* p, std::size_t n);
+	std::size_t size() const {
+		return static_cast<std::size_t>(m_appended - m_written);
+	}
+
+	const int m_fd;
+	const std::chrono::milliseconds m_interval;
+	std::vector<char> m_ring;
+	std::uint64_t m_appended = 0; // positions in the ring are these counters modulo its size
+	std::uint64_t m_written = 0;
+	std::uint64_t m_flush_target = 0; // written up to here as soon as possible
+	bool m_stop = false;
+	std::mutex m_mutex;
+	std::condition_variable m_data_available; // for the writer thread
+	std::condition_variable m_data_written;   // for full rings and flush_and_wait()
+	std::thread m_thread;
+};
+
+}
+
+#endif
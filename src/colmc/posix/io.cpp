@@ -0,0 +1,60 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#if defined(__unix__) || defined(__linux__) || (defined(__APPLE__) && defined(__MACH__))
+
+#include <unistd.h>
+#include <limits.h>
+#include <cerrno>
+#include <algorithm>
+#include <colmc/posix/io.h>
+
+namespace {
+
+#ifdef IOV_MAX
+constexpr std::size_t max_parts = IOV_MAX;
+#else
+constexpr std::size_t max_parts = 16u; // the minimum POSIX allows
+#endif
+
+}
+
+namespace colmc {
+
+void write_all(int fd, const char* p, std::size_t n) {
+	while (n > 0) {
+		const auto num_written = ::write(fd, p, n);
+		if (num_written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return; // nothing we can do about it
+		}
+		p += num_written;
+		n -= static_cast<std::size_t>(num_written);
+	}
+}
+
+void writev_all(int fd, iovec* parts, std::size_t num_parts) {
+	while (num_parts > 0) {
+		const auto num_written = ::writev(fd, parts, static_cast<int>(std::min(num_parts, max_parts)));
+		if (num_written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return; // nothing we can do about it
+		}
+		auto remaining = static_cast<std::size_t>(num_written);
+		while ((num_parts > 0) && (remaining >= parts->iov_len)) {
+			remaining -= parts->iov_len;
+			++parts;
+			--num_parts;
+		}
+		if (num_parts > 0) {
+			parts->iov_base = static_cast<char*>(parts->iov_base) + remaining;
+			parts->iov_len -= remaining;
+		}
+	}
+}
+
+}
+
+#endif
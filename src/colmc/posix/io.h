@@ -0,0 +1,19 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#ifndef colmc_io_h_INCLUDED
+#define colmc_io_h_INCLUDED
+
+#include <cstddef>
+#include <sys/uio.h>
+
+namespace colmc {
+
+//! \brief Writes all of [p, p + n) to fd, retrying after partial writes and EINTR.
+//! Other errors drop the rest, as there is nothing we can do about them.
+void write_all(int fd, const char* p, std::size_t n);
+
+//! \brief Like write_all(), but gathers the parts with writev(). The parts are modified.
+void writev_all(int fd, iovec* parts, std::size_t num_parts);
+
+}
+
+#endif
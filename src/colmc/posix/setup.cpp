@@ -4,63 +4,744 @@
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <termios.h>
+#include <poll.h>
+#include <limits.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <cerrno>
 #include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
 #include <cassert>
+#include <memory>
+#include <atomic>
+#include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <limits>
+#include <streambuf>
 #include <iostream>
 #include <colmc/setup.h>
 #include <colmc/raw_input.h>
 #include <colmc/term_size.h>
+#include <colmc/algorithms.h>
+#include <colmc/styles.h>
+#include <colmc/input_buffer.h>
+#include <colmc/key_decoder.h>
+#include <colmc/key_queue.h>
+#include <colmc/sgr_filter.h>
+#include <colmc/ansi_stripper.h>
+#include <colmc/output.h>
+#include <colmc/posix/async_writer.h>
+#include <colmc/posix/io.h>
 
 using namespace colmc;
 
 namespace {
 
+constexpr std::size_t default_buf_size = 64u * 1024u;
 bool raw_input_mode = false;
 bool stdout_redirected = false;
 bool is_setup = false;
+bool allow_styles = false;
+bool bracketed_paste = false;
+bool mouse_tracking = false;
+strip_mode stdout_strip = strip_mode::none; // config::strip_sequences
 termios old_terminal_settings;
 termios new_terminal_settings;
-int push_back_ch = -1;
-std::mutex push_back_lock;
+input_buffer input;
+constexpr int sequence_timeout_ms = 20; // for the rest of a split escape sequence or UTF-8 char
 
-std::size_t bytes_available() {
-	std::unique_lock<std::mutex> lock{push_back_lock};
-	int n = 0;
-	if (ioctl(STDIN_FILENO, FIONREAD, &n) < 0) {
-		n = 0;
+key_decoder decoder;
+
+bool open_pipe(int (&fds)[2]) {
+	if (::pipe(fds) != 0) {
+		fds[0] = fds[1] = -1;
+		return false;
 	}
-	if (push_back_ch != -1) {
-		++n;
+	for (const int fd : fds) {
+		::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+		::fcntl(fd, F_SETFD, FD_CLOEXEC);
+	}
+	return true;
+}
+
+void close_pipe(int (&fds)[2]) {
+	for (int& fd : fds) {
+		if (fd >= 0) {
+			::close(fd);
+			fd = -1;
+		}
+	}
+}
+
+void signal_pipe(int (&fds)[2]) {
+	const char c = '\0';
+	const auto num_written = ::write(fds[1], &c, 1u); // a full pipe has been signalled already
+	static_cast<void>(num_written);
+}
+
+void drain_pipe(int (&fds)[2]) {
+	char buf[64];
+	while (::read(fds[0], buf, sizeof(buf)) > 0) {
+	}
+}
+
+// The terminal size is cached and only asked for again after a SIGWINCH
+struct sigaction old_sigwinch_action;
+bool sigwinch_handler_installed = false;
+std::atomic<bool> size_changed{true};
+std::atomic<std::uint32_t> cached_size{0}; // columns in the upper, rows in the lower 16 bits; 0: unknown
+std::atomic<bool> resize_events{false}; // read in the signal handler
+int resize_pipe[2] = { -1, -1 }; // SIGWINCH handler -> get_key() or input thread
+bool use_input_thread = false; // see below
+std::atomic<bool> resize_event_pending{false};
+
+static_assert(std::atomic<bool>::is_always_lock_free, "needed in the signal handler");
+
+void on_sigwinch(int signal, siginfo_t* info, void* context) {
+	const int saved_errno = errno;
+	size_changed = true;
+	if (resize_events) {
+		resize_event_pending = true;
+		signal_pipe(resize_pipe);
+	}
+	// the application may be interested as well
+	if ((old_sigwinch_action.sa_flags & SA_SIGINFO) != 0) {
+		if (old_sigwinch_action.sa_sigaction != nullptr) {
+			old_sigwinch_action.sa_sigaction(signal, info, context);
+		}
+	}
+	else {
+		const auto old_handler = old_sigwinch_action.sa_handler;
+		if ((old_handler != SIG_DFL) && (old_handler != SIG_IGN)) {
+			old_handler(signal);
+		}
+	}
+	errno = saved_errno;
+}
+
+void install_sigwinch_handler() {
+	struct sigaction action;
+	std::memset(&action, 0, sizeof(action));
+	action.sa_sigaction = on_sigwinch; // SA_SIGINFO to have the info for a chained handler that wants it
+	sigemptyset(&action.sa_mask);
+	action.sa_flags = SA_RESTART | SA_SIGINFO;
+	size_changed = true;
+	sigwinch_handler_installed = (::sigaction(SIGWINCH, &action, &old_sigwinch_action) == 0);
+}
+
+void uninstall_sigwinch_handler() {
+	if (sigwinch_handler_installed) {
+		::sigaction(SIGWINCH, &old_sigwinch_action, nullptr);
+		sigwinch_handler_installed = false;
+	}
+}
+
+// Keeps track of the time left of a timeout (in ms, negative: forever)
+class deadline {
+public:
+	explicit deadline(int timeout_ms)
+		:m_forever(timeout_ms < 0)
+		,m_end(std::chrono::steady_clock::now() + std::chrono::milliseconds(m_forever ? 0 : timeout_ms))
+	{
+	}
+
+	int remaining_ms() const {
+		if (m_forever) {
+			return -1;
+		}
+		const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(m_end - std::chrono::steady_clock::now()).count();
+		return (ms > 0) ? static_cast<int>(ms) : 0;
+	}
+
+private:
+	bool m_forever;
+	std::chrono::steady_clock::time_point m_end;
+};
+
+// Sets k to key_enum::resize if the terminal has been resized since the last call
+bool take_resize_event(key& k) {
+	if (resize_events) {
+		drain_pipe(resize_pipe); // before taking the flag, so that fill_input() doesn't wake up for an event taken here
+	}
+	if (!resize_event_pending.exchange(false)) {
+		return false;
+	}
+	k = key{};
+	k.special = key_enum::resize;
+	return true;
+}
+
+// Reads as much as is available (and fits) with one syscall. Waits up to timeout_ms
+// for input (forever if negative). Returns false if nothing could be read.
+// Also returns false when the terminal has been resized (with config::resize_events and
+// without the input thread, which waits for the resize pipe itself).
+bool fill_input(int timeout_ms) {
+	const bool wait_for_resize = (resize_events && (!use_input_thread));
+	if ((timeout_ms >= 0) || wait_for_resize) {
+		const deadline end{timeout_ms};
+		for (;;) {
+			pollfd fds[2] = { { STDIN_FILENO, POLLIN, 0 }, { resize_pipe[0], POLLIN, 0 } };
+			int num_ready;
+			do {
+				num_ready = ::poll(fds, wait_for_resize ? 2u : 1u, end.remaining_ms());
+			} while ((num_ready < 0) && (errno == EINTR));
+			if (num_ready <= 0) {
+				return false;
+			}
+			if (fds[1].revents == 0) {
+				break;
+			}
+			drain_pipe(resize_pipe);
+			if (resize_event_pending) {
+				return false;
+			}
+			if (fds[0].revents != 0) { // the byte of a resize that has been taken already
+				break;
+			}
+		}
+	}
+	char* p[2];
+	std::size_t n[2];
+	const std::size_t num_ranges = input.free_ranges(p, n);
+	if (num_ranges == 0) {
+		return false;
+	}
+	iovec iov[2];
+	for (std::size_t i = 0; i < num_ranges; ++i) {
+		iov[i].iov_base = p[i];
+		iov[i].iov_len = n[i];
+	}
+	ssize_t num_read;
+	do {
+		num_read = ::readv(STDIN_FILENO, iov, static_cast<int>(num_ranges));
+	} while ((num_read < 0) && (errno == EINTR));
+	if (num_read <= 0) {
+		return false;
+	}
+	input.commit(static_cast<std::size_t>(num_read));
+	return true;
+}
+
+// Decodes the buffered input until a key is complete. Pasted text is taken in bulk.
+bool decode_buffered(key& k) {
+	while (!input.empty()) {
+		if (decoder.in_paste()) {
+			const char* p;
+			const std::size_t taken = decoder.feed_paste(p, input.readable(p));
+			input.consume(taken);
+			if (taken > 0) {
+				continue;
+			}
+		}
+		// up to the end of the contiguous part of the ring, without any call per byte
+		const char* p;
+		const std::size_t n = input.readable(p);
+		std::size_t i = 0;
+		bool complete;
+		do {
+			complete = decoder.feed(p[i++], k);
+		} while ((!complete) && (i < n) && (!decoder.in_paste())); // a paste is taken in bulk above
+		input.consume(i);
+		if (complete) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Waiting time for the rest of a pending key (a lone ESC is the ESC key, unless more follows right now)
+int pending_key_timeout_ms(int timeout_ms) {
+	if ((!decoder.pending()) || decoder.in_paste()) {
+		return timeout_ms;
+	}
+	return decoder.in_sequence() ? sequence_timeout_ms : 0;
+}
+
+int to_timeout_ms(std::chrono::milliseconds timeout) {
+	const auto ms = timeout.count();
+	if (ms <= 0) {
+		return 0;
+	}
+	return (ms < std::numeric_limits<int>::max()) ? static_cast<int>(ms) : std::numeric_limits<int>::max();
+}
+
+// State of the background input thread (config::input_thread). The thread owns input and
+// decoder then; the application only pops from key_events.
+key_queue key_events;
+spsc_queue<std::string, 4u> paste_events; // the texts of the key_enum::paste in key_events
+std::string last_paste; // text of the last key_enum::paste taken from key_events
+spsc_queue<std::string, 8u> free_pastes; // the buffers of replaced last_paste, back to the input thread
+std::thread input_thread;
+std::atomic<bool> input_thread_running{false};
+int wake_pipe[2] = { -1, -1 };   // teardown() -> input thread
+int notify_pipe[2] = { -1, -1 }; // input thread -> blocking get_key()
+int room_pipe[2] = { -1, -1 };   // pop_keys() -> input thread waiting for room in the queues
+std::atomic<bool> waiting_for_room{false};
+
+bool queues_full() {
+	return key_events.full() || paste_events.full();
+}
+
+// Called by the input thread when the queues are full. Returns false on teardown.
+bool wait_for_room() {
+	waiting_for_room = true;
+	std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with the one in pop_keys()
+	bool running = true;
+	if (queues_full()) {
+		pollfd fds[2] = { { wake_pipe[0], POLLIN, 0 }, { room_pipe[0], POLLIN, 0 } };
+		if ((::poll(fds, 2u, -1) < 0) && (errno != EINTR)) {
+			running = false;
+		}
+		running = running && (fds[0].revents == 0);
+	}
+	waiting_for_room = false;
+	drain_pipe(room_pipe);
+	return running;
+}
+
+void read_keys_in_background() {
+	key k;
+	bool keys_added = false;
+	for (;;) {
+		while ((!key_events.full()) && (!paste_events.full()) && decode_buffered(k)) {
+			if (k.special == key_enum::paste) { // the text first, so it is there when the key is taken
+				std::string text;
+				free_pastes.pop(&text, 1u); // the decoder gets a used buffer (if there is one) for the next paste
+				text.swap(decoder.pasted_text());
+				paste_events.push(std::move(text));
+			}
+			key_events.push(k);
+			keys_added = true;
+		}
+		if (keys_added) {
+			signal_pipe(notify_pipe);
+			keys_added = false;
+		}
+		if ((!key_events.full()) && take_resize_event(k)) {
+			key_events.push(k);
+			signal_pipe(notify_pipe);
+		}
+		if (queues_full()) {
+			if (!wait_for_room()) {
+				break;
+			}
+			continue;
+		}
+		pollfd fds[3] = { { wake_pipe[0], POLLIN, 0 }, { STDIN_FILENO, POLLIN, 0 }, { resize_pipe[0], POLLIN, 0 } };
+		const nfds_t num_fds = resize_events ? 3u : 2u;
+		const int num_ready = ::poll(fds, num_fds, pending_key_timeout_ms(-1));
+		if (num_ready < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		if (fds[0].revents != 0) { // teardown
+			break;
+		}
+		if (num_ready == 0) {
+			if ((!key_events.full()) && decoder.flush(k)) {
+				key_events.push(k);
+				keys_added = true;
+			}
+			continue;
+		}
+		if (fds[2].revents != 0) {
+			drain_pipe(resize_pipe); // the event is taken at the beginning of the loop
+			continue;
+		}
+		if ((fds[1].revents != 0) && (!fill_input(-1))) { // end of input
+			break;
+		}
+	}
+	input_thread_running = false;
+	signal_pipe(notify_pipe);
+}
+
+void start_input_thread() {
+	key_events.clear();
+	paste_events.clear();
+	free_pastes.clear();
+	if (!(open_pipe(wake_pipe) && open_pipe(notify_pipe) && open_pipe(room_pipe))) {
+		close_pipe(wake_pipe);
+		close_pipe(notify_pipe);
+		close_pipe(room_pipe);
+		return;
+	}
+	input_thread_running = true;
+	use_input_thread = true; // before the thread starts, which reads it in fill_input()
+	input_thread = std::thread{read_keys_in_background};
+}
+
+void stop_input_thread() {
+	if (input_thread.joinable()) {
+		signal_pipe(wake_pipe);
+		input_thread.join();
 	}
-	return static_cast<std::size_t>(n);
+	close_pipe(wake_pipe);
+	close_pipe(notify_pipe);
+	close_pipe(room_pipe);
+	use_input_thread = false;
 }
 
-int read_ch() {
-	std::unique_lock<std::mutex> lock{push_back_lock};
-	if (push_back_ch != -1) {
-		const auto result = push_back_ch;
-		push_back_ch = -1;
+// Takes keys from key_events, at most one paste (as the last one). Only makes a syscall if
+// the input thread waits for room in the queues.
+std::size_t pop_keys(key* keys, std::size_t max_keys) {
+	std::size_t n = 0;
+	while ((n < max_keys) && (key_events.pop(keys + n, 1u) == 1u)) {
+		if (keys[n++].special == key_enum::paste) {
+			free_pastes.push(std::move(last_paste)); // dropped if the input thread has enough buffers
+			paste_events.pop(&last_paste, 1u);
+			break;
+		}
+	}
+	if (n > 0) {
+		std::atomic_thread_fence(std::memory_order_seq_cst); // see wait_for_room()
+		if (waiting_for_room.exchange(false)) {
+			signal_pipe(room_pipe);
+		}
+	}
+	return n;
+}
+
+// timeout_ms: 0 doesn't wait, negative waits forever
+key get_queued_key(int timeout_ms) {
+	key result;
+	if ((pop_keys(&result, 1u) == 1u) || (timeout_ms == 0)) {
 		return result;
 	}
-	unsigned char ch;
-	if (read(STDIN_FILENO, &ch, 1) == 1) {
-		const auto result = static_cast<int>(ch);
+	std::cout.flush();
+	const deadline end{timeout_ms};
+	for (;;) {
+		drain_pipe(notify_pipe); // before looking into the queue, so no signal gets lost
+		if (pop_keys(&result, 1u) == 1u) {
+			return result;
+		}
+		const int remaining_ms = end.remaining_ms();
+		if ((!input_thread_running) || (remaining_ms == 0)) {
+			return result;
+		}
+		pollfd pfd{ notify_pipe[0], POLLIN, 0 };
+		if ((::poll(&pfd, 1, remaining_ms) < 0) && (errno != EINTR)) {
+			return result;
+		}
+	}
+}
+
+// timeout_ms: 0 doesn't wait, negative waits forever
+key read_key(int timeout_ms) {
+	key result;
+	if (use_input_thread) {
+		return get_queued_key(timeout_ms);
+	}
+	if (input.empty() && (!decoder.pending()) && (timeout_ms == 0) && (!fill_input(0))) {
+		take_resize_event(result);
 		return result;
 	}
-	return -1;
+	std::cout.flush();
+	const deadline end{timeout_ms};
+	for (;;) {
+		if (decode_buffered(result) || take_resize_event(result)) {
+			return result;
+		}
+		if (!fill_input(pending_key_timeout_ms(end.remaining_ms()))) {
+			if (take_resize_event(result)) {
+				return result;
+			}
+			decoder.flush(result);
+			return result;
+		}
+	}
+}
+
+// The writes of write_atomically() that the kernel doesn't split (up to PIPE_BUF bytes) take
+// no lock. A longer one must not get a short one in between, so it raises long_line_writing
+// and waits until no thread is in the middle of a short write; each thread announces those in
+// a slot of its own, so the short writes don't share a cache line. The slots are never freed;
+// those of ended threads are reused (like the hazard slots of the style registry).
+// A write() takes a few microseconds unless the terminal is slow or the pipe is full, so both
+// sides spin only briefly before they block: the short writers on long_line_mutex, the long
+// one on line_written.
+struct alignas(64) line_write_slot {
+	std::atomic<bool> writing{false};
+	std::atomic<bool> in_use{true};
+	line_write_slot* next = nullptr;
+};
+
+std::atomic<line_write_slot*> line_write_slots{nullptr};
+std::atomic<bool> long_line_writing{false};
+std::mutex long_line_mutex; // between the long lines, and for short ones waiting for a long one
+std::mutex line_written_mutex;
+std::condition_variable line_written; // a short write ended while a long line waits for it
+constexpr unsigned line_write_spins = 64u;
+
+line_write_slot* acquire_line_write_slot() {
+	for (line_write_slot* slot = line_write_slots.load(std::memory_order_acquire); slot != nullptr; slot = slot->next) {
+		bool in_use = false;
+		if (slot->in_use.compare_exchange_strong(in_use, true)) {
+			return slot;
+		}
+	}
+	auto* slot = new line_write_slot;
+	slot->next = line_write_slots.load(std::memory_order_relaxed);
+	while (!line_write_slots.compare_exchange_weak(slot->next, slot, std::memory_order_release, std::memory_order_relaxed)) {
+	}
+	return slot;
+}
+
+thread_local line_write_slot* this_thread_line_slot = nullptr; // trivially destructible, see below
+
+struct line_write_slot_releaser {
+	~line_write_slot_releaser() {
+		if (this_thread_line_slot != nullptr) {
+			this_thread_line_slot->in_use.store(false, std::memory_order_release);
+			this_thread_line_slot = nullptr;
+		}
+	}
+};
+
+line_write_slot& this_thread_line_write_slot() {
+	if (this_thread_line_slot == nullptr) { // again after the thread's destructors ran (lines written at exit)
+		thread_local line_write_slot_releaser releaser;
+		this_thread_line_slot = acquire_line_write_slot();
+	}
+	return *this_thread_line_slot;
+}
+
+void end_short_write(line_write_slot& slot) {
+	slot.writing.store(false); // seq_cst: either the long line sees it, or its flag is seen here
+	if (long_line_writing.load()) {
+		std::lock_guard<std::mutex> lock{line_written_mutex};
+		line_written.notify_all();
+	}
 }
 
-void push_back(char c) {
-	std::unique_lock<std::mutex> lock{push_back_lock};
-	assert(push_back_ch == -1);
-	push_back_ch = static_cast<unsigned int>(c);
+void write_short_line(int fd, const char* p, std::size_t n) {
+	line_write_slot& slot = this_thread_line_write_slot();
+	for (;;) {
+		slot.writing.store(true); // seq_cst: either the long line sees it, or it is seen here
+		if (!long_line_writing.load()) {
+			break;
+		}
+		end_short_write(slot);
+		for (unsigned i = 0; long_line_writing.load(std::memory_order_acquire); ++i) {
+			if (i < line_write_spins) {
+				std::this_thread::yield();
+			}
+			else {
+				std::lock_guard<std::mutex> lock{long_line_mutex}; // the long line holds it while it is written
+			}
+		}
+	}
+	write_all(fd, p, n);
+	end_short_write(slot);
 }
 
-char itoc(int x) {
-	return static_cast<char>(static_cast<unsigned char>(x));
+void write_long_line(int fd, const char* p, std::size_t n) {
+	std::lock_guard<std::mutex> lock{long_line_mutex};
+	long_line_writing.store(true); // seq_cst, see end_short_write()
+	for (line_write_slot* slot = line_write_slots.load(std::memory_order_acquire); slot != nullptr; slot = slot->next) {
+		for (unsigned i = 0; slot->writing.load(); ++i) {
+			if (i < line_write_spins) {
+				std::this_thread::yield();
+				continue;
+			}
+			std::unique_lock<std::mutex> written_lock{line_written_mutex};
+			line_written.wait(written_lock, [slot]() { return !slot->writing.load(); });
+		}
+	}
+	write_all(fd, p, n);
+	long_line_writing.store(false, std::memory_order_release);
+}
+
+std::unique_ptr<async_writer> stdout_writer; // config::async_output
+
+// Called before anything is written to STDOUT_FILENO directly (bypassing stdio), so that what
+// printf() wrote before stays in front (nothing to do if its buffer is empty)
+void flush_stdio() {
+	std::fflush(stdout);
+}
+
+void write_stdout(const char* p, std::size_t n) {
+	if (stdout_writer) {
+		stdout_writer->write(p, n);
+	}
+	else {
+		flush_stdio();
+		write_all(STDOUT_FILENO, p, n);
+	}
 }
 
+// see https://no-color.org
+bool no_color_requested() {
+	const char* value = std::getenv("NO_COLOR");
+	return (value != nullptr) && (value[0] != '\0');
+}
+
+// Replaces the style tags by escape sequences and/or drops redundant SGR sequences while the
+// text is streamed through it and writes the result directly to stdout. The terminal understands
+// the escape sequences itself, so in contrast to Windows they don't need any further treatment.
+// With config::strip_sequences, the sequences and style tags are stripped instead if stdout isn't a
+// terminal (or only the colors if NO_COLOR is set).
+class ostreambuf : public std::basic_streambuf<char>
+{
+public:
+	using base = std::basic_streambuf<char>;
+
+	ostreambuf(std::size_t buf_size, bool rewrite_styles, bool minimize_sgr, strip_mode strip)
+		:m_buf(buf_size, '\0')
+		,m_stripper(strip, rewrite_styles)
+		,m_rewrite_styles(rewrite_styles)
+		,m_minimize_sgr(minimize_sgr)
+		,m_strip(strip != strip_mode::none)
+	{
+		m_rewritten.reserve(buf_size);
+		m_out.reserve(buf_size);
+		reset_region();
+	}
+
+	virtual ~ostreambuf() {
+		finish();
+	}
+
+	style_stack& styles() {
+		return m_rewriter.stack();
+	}
+
+	// outputs everything including an incomplete style tag or escape sequence at the end
+	void finish() {
+		sync();
+		m_out.clear();
+		if (m_strip) {
+			m_stripper.finish(m_out);
+			write_stdout(m_out.data(), m_out.size());
+			return;
+		}
+		m_rewritten.clear();
+		m_rewriter.finish(m_rewritten);
+		if (m_minimize_sgr) {
+			m_filter.filter(m_rewritten.data(), m_rewritten.size(), m_out);
+			m_filter.finish(m_out);
+		}
+		else {
+			m_out.swap(m_rewritten);
+		}
+		write_stdout(m_out.data(), m_out.size());
+	}
+
+protected:
+
+	// called when the buffer is full
+	int_type overflow(int_type ch = std::char_traits<char>::eof()) override {
+		sync();
+		if (ch != std::char_traits<char>::eof()) {
+			*pptr() = static_cast<char>(ch);
+			pbump(1);
+		}
+		return std::char_traits<char>::not_eof(ch);
+	}
+
+	// big chunks don't take the detour through the buffer
+	std::streamsize xsputn(const char* p, std::streamsize n) override {
+		const auto num = static_cast<std::size_t>(n);
+		if (num <= static_cast<std::size_t>(epptr() - pptr())) {
+			std::memcpy(pptr(), p, num);
+			pbump(static_cast<int>(n));
+		}
+		else {
+			sync();
+			handle(p, num);
+		}
+		return n;
+	}
+
+	int sync() override {
+		handle(m_buf.data(), static_cast<std::size_t>(pptr() - m_buf.data()));
+		reset_region();
+		return 0;
+	}
+
+	void reset_region() {
+		base::setp(m_buf.data(), m_buf.data() + m_buf.size());
+	}
+
+	// number of chars at the beginning of [p, p + n) that need no treatment
+	std::size_t count_plain(const char* p, std::size_t n) const {
+		if (m_strip) {
+			return m_stripper.count_plain(p, n);
+		}
+		if (m_rewrite_styles && m_minimize_sgr) {
+			return count_until_either(p, n, esc, '<');
+		}
+		return m_rewrite_styles ? count_until(p, n, '<') : count_until_esc(p, n);
+	}
+
+	void handle(const char* p, std::size_t n) {
+		if ((!m_rewriter.has_pending()) && (!m_filter.has_pending()) && (!m_stripper.has_pending()) && (count_plain(p, n) == n)) {
+			write_stdout(p, n); // nothing to do
+			return;
+		}
+		if (m_strip) { // neither style tags nor SGR sequences need to be understood then
+			m_out.clear(); // keeps the capacity
+			m_stripper.filter(p, n, m_out);
+			write_stdout(m_out.data(), m_out.size());
+			return;
+		}
+		if (m_rewrite_styles && (!m_minimize_sgr) && (!stdout_writer)) {
+			write_rewritten(p, n);
+			return;
+		}
+		if (m_rewrite_styles) {
+			m_rewritten.clear(); // keeps the capacity
+			m_rewriter.rewrite(p, n, m_rewritten);
+			p = m_rewritten.data();
+			n = m_rewritten.size();
+		}
+		if (m_minimize_sgr) {
+			m_out.clear(); // keeps the capacity
+			m_filter.filter(p, n, m_out);
+			p = m_out.data();
+			n = m_out.size();
+		}
+		write_stdout(p, n);
+	}
+
+	// The text isn't copied: its pieces between the style tags go to writev() together with the
+	// escape sequences replacing the tags, so a large message with few tags costs one syscall.
+	void write_rewritten(const char* p, std::size_t n) {
+		m_pieces.clear(); // keeps the capacity
+		m_rewriter.rewrite(p, n, m_pieces);
+		const std::string& sequences = m_rewriter.sequences();
+		m_parts.clear();
+		for (const auto& piece : m_pieces) {
+			const char* data = (piece.text != nullptr) ? piece.text : (sequences.data() + piece.offset);
+			m_parts.push_back(iovec{const_cast<char*>(data), piece.size});
+		}
+		flush_stdio();
+		writev_all(STDOUT_FILENO, m_parts.data(), m_parts.size());
+	}
+
+	std::vector<char> m_buf;
+	std::vector<char> m_rewritten; // kept as members to avoid repetitive allocations
+	std::vector<char> m_out;
+	std::vector<output_piece> m_pieces;
+	std::vector<iovec> m_parts;
+	style_tag_rewriter m_rewriter;
+	sgr_filter m_filter;
+	ansi_stripper m_stripper;
+	bool m_rewrite_styles;
+	bool m_minimize_sgr;
+	bool m_strip;
+};
+
+std::unique_ptr<ostreambuf> cout_buf;
+std::basic_streambuf<char>* old_cout_buf = nullptr;
+
 }
 
 namespace colmc {
@@ -85,21 +766,93 @@ void setup(config cfg) {
 		new_terminal_settings.c_cc[VMIN] = 1;
 		new_terminal_settings.c_cc[VTIME] = 0;
 		tcsetattr(STDIN_FILENO, TCSANOW, &new_terminal_settings);
-		push_back_ch = -1;
+		input.clear();
+		if (cfg.resize_events && open_pipe(resize_pipe)) {
+			resize_events = true;
+		}
+		if (cfg.bracketed_paste) {
+			std::cout.flush();
+			write_all(STDOUT_FILENO, "\x1B[?2004h", 8u);
+			bracketed_paste = true;
+		}
+		if (cfg.mouse_tracking) { // button event tracking (clicks, drags, wheel) in the SGR format
+			std::cout.flush();
+			write_all(STDOUT_FILENO, "\x1B[?1002h\x1B[?1006h", 16u);
+			mouse_tracking = true;
+		}
+		if (cfg.input_thread) {
+			start_input_thread();
+		}
+	}
+	if (resize_events || (::isatty(STDOUT_FILENO) != 0)) {
+		install_sigwinch_handler();
+	}
+	allow_styles = cfg.allow_styles;
+	use_thread_local_style_stacks(cfg.thread_local_styles);
+	if (cfg.async_output) {
+		std::cout.flush();
+		stdout_writer = std::make_unique<async_writer>(STDOUT_FILENO, std::chrono::milliseconds{cfg.async_interval_ms});
+	}
+	if (cfg.strip_sequences) {
+		if (::isatty(STDOUT_FILENO) == 0) {
+			stdout_strip = strip_mode::all;
+		}
+		else if (no_color_requested()) {
+			stdout_strip = strip_mode::sgr;
+		}
+	}
+	if (allow_styles || cfg.minimize_sgr || stdout_writer || (stdout_strip != strip_mode::none)) {
+		std::cout.flush();
+		std::fflush(stdout); // the stream buffer writes to the file descriptor directly
+		cout_buf = std::make_unique<ostreambuf>(default_buf_size, allow_styles, cfg.minimize_sgr, stdout_strip);
+		old_cout_buf = std::cout.rdbuf(cout_buf.get());
 	}
 	std::atexit(teardown);
 	is_setup = true;
 }
 
+void flush_and_wait() {
+	std::cout.flush();
+	if (stdout_writer) {
+		stdout_writer->flush_and_wait();
+	}
+}
+
 void teardown() {
+	if (cout_buf) {
+		cout_buf->finish();
+		std::cout.rdbuf(old_cout_buf);
+		cout_buf.reset();
+		old_cout_buf = nullptr;
+	}
+	stdout_writer.reset(); // writes what's left
+	stop_input_thread();
+	uninstall_sigwinch_handler();
+	resize_events = false;
+	resize_event_pending = false;
+	close_pipe(resize_pipe);
+	if (bracketed_paste) {
+		std::cout.flush();
+		write_all(STDOUT_FILENO, "\x1B[?2004l", 8u);
+		bracketed_paste = false;
+	}
+	if (mouse_tracking) {
+		std::cout.flush();
+		write_all(STDOUT_FILENO, "\x1B[?1006l\x1B[?1002l", 16u);
+		mouse_tracking = false;
+	}
 	if (raw_input_mode) {
 		tcsetattr(STDIN_FILENO, TCSANOW, &old_terminal_settings);
 		std::memset(&old_terminal_settings, 0, sizeof(old_terminal_settings));
-		push_back_ch = -1;
+		input.clear();
+		decoder = key_decoder{};
 		tcflush(STDIN_FILENO, TCIFLUSH);
 	}
 	raw_input_mode = false;
 	stdout_redirected = false;
+	allow_styles = false;
+	stdout_strip = strip_mode::none;
+	use_thread_local_style_stacks(false);
 	is_setup = false;
 }
 
@@ -107,139 +860,141 @@ bool key_pressed() {
 	if (!raw_input_mode) {
 		return false;
 	}
-	return (bytes_available() > 0);
+	if (use_input_thread) {
+		return !key_events.empty();
+	}
+	return ((!input.empty()) || fill_input(0) || resize_event_pending);
 }
 
 key get_key(bool block_until_pressed) {
-	key result;
 	if (!raw_input_mode) {
-		return result; // default constructor is "no key pressed"
+		return key{}; // default constructor is "no key pressed"
 	}
-	auto avail = bytes_available();
-	if ((avail == 0) && (!block_until_pressed)) {
-		return result; // default constructor is "no key pressed"
+	return read_key(block_until_pressed ? -1 : 0);
+}
+
+key get_key(std::chrono::milliseconds timeout) {
+	if (!raw_input_mode) {
+		return key{};
 	}
-	std::cout.flush();
-	const int first_ch = read_ch();
-	if (first_ch < 0) {
-		return result; // error: there are bytes available but read() could't fetch them
-	}
-	if (first_ch < 128) {
-		if (first_ch != '\x1B') { // regular non-esc ASCII char (UTF-8 sequence of length 1)
-			result.special = key_enum::regular;
-			result.regular.bytes[0] = itoc(first_ch);
-			result.regular.bytes[1] = '\0';
-			return result;
-		}
-		// esc handling. 2 cases: ESC plus '[' or single escape followed by sth. else
-		avail = bytes_available();
-		if (avail == 0) { // single escape without further sequence
-			result.special = key_enum::regular;
-			result.regular.bytes[0] = '\x1B';
-			result.regular.bytes[1] = '\0';
-			return result;
-		}
-		const int second_ch = read_ch();
-		if (second_ch < 0) {
-			return result; // error: there are bytes available but read() could't fetch them
-		}
-		if (second_ch != '[') { // no escape sequence: So we return esc and push_back the other char for next read
-			push_back(itoc(second_ch));
-			result.special = key_enum::regular;
-			result.regular.bytes[0] = '\x1B';
-			result.regular.bytes[1] = '\0';
-			return result;
-		}
-		avail = bytes_available();
-		if (avail < 1) { // escape '[' without anything behind?
-			result.special = key_enum::unknown;
-			return result;
-		}
-		const int third_ch = read_ch();
-		if (third_ch < 0) {
-			return result; // error: there are bytes available but read() could't fetch them
-		}
-		switch(third_ch) {
-			case /* ESC [ */ 'A': result.special = key_enum::up; break;
-			case /* ESC [ */ 'B': result.special = key_enum::down; break;
-			case /* ESC [ */ 'C': result.special = key_enum::right; break;
-			case /* ESC [ */ 'D': result.special = key_enum::left; break;
-			case /* ESC [ */ 'H': result.special = key_enum::home; break;
-			case /* ESC [ */ 'F': result.special = key_enum::end; break;
-			default: {
-				avail = bytes_available();
-				if (avail < 1) { // escape sequence without anything behind?
-					result.special = key_enum::unknown;
-					return result;
-				}
-				const int fourth_ch = read_ch();
-				if (fourth_ch < 0) {
-					return result; // error: there are bytes available but read() could't fetch them
-				}
-				if (fourth_ch != '~') {
-					result.special = key_enum::unknown;
-					return result;
-				}
-				switch(third_ch) {
-					case /* ESC [ */ '2' /* ~ */: result.special = key_enum::insert; break;
-					case /* ESC [ */ '3' /* ~ */: result.special = key_enum::del; break;
-					case /* ESC [ */ '5' /* ~ */: result.special = key_enum::page_up; break;
-					case /* ESC [ */ '6' /* ~ */: result.special = key_enum::page_down; break;
-					default:  result.special = key_enum::unknown; break;
-				}
-			}
-		}
-		return result;
+	return read_key(to_timeout_ms(timeout));
+}
+
+int input_fd() {
+	if (!raw_input_mode) {
+		return -1;
 	}
-	// first_ch >= 128: multi-byte UTF-8 sequence
-	avail = bytes_available() + 1u; // +1: first char already read
-	std::size_t needed_avail;
-	if ((static_cast<unsigned>(first_ch) & 0xE0) == 0xC0) { // 2-byte UTF-8 sequence
-		needed_avail = 2;
+	return use_input_thread ? notify_pipe[0] : STDIN_FILENO;
+}
+
+std::size_t read_keys(key* keys, std::size_t max_keys) {
+	if (!raw_input_mode) {
+		return 0;
 	}
-	else if ((static_cast<unsigned>(first_ch) & 0xF0) == 0xE0) { // 3-byte UTF-8 sequence
-		needed_avail = 3;
+	if (use_input_thread) {
+		drain_pipe(notify_pipe);
+		return pop_keys(keys, max_keys);
 	}
-	else {
-		needed_avail = 4;
+	if (input.empty()) {
+		fill_input(0); // doesn't block even if the fd wasn't ready after all
 	}
-	if (avail < needed_avail) { // not a full UTF-8 in buffer? Don't know how to deal with that...
-		result.special = key_enum::unknown;
-		return result;
+	std::size_t n = 0;
+	if ((max_keys > 0) && take_resize_event(keys[n])) {
+		++n;
 	}
-	result.special = key_enum::regular;
-	int bytes[4] = {'\0', '\0', '\0', '\0'};
-	bytes[0] = first_ch;
-	bytes[1] = read_ch();
-	if (needed_avail > 2) {
-		bytes[2] = read_ch();
+	while ((n < max_keys) && decode_buffered(keys[n])) {
+		if (keys[n++].special == key_enum::paste) { // the next paste would reuse the buffer
+			return n;
+		}
 	}
-	if (needed_avail > 3) {
-		bytes[3] = read_ch();
+	// A lone ESC is the ESC key. The rest of an incomplete sequence will make the fd ready again.
+	if ((n < max_keys) && decoder.pending() && (!decoder.in_sequence()) && decoder.flush(keys[n])) {
+		++n;
 	}
-	for (std::size_t i=0; i<4; ++i) {
-		const auto c = bytes[i];
-		if (c == -1) {
-			result.special = key_enum::unknown;
-			return result;
+	return n;
+}
+
+std::size_t poll_keys(key* keys, std::size_t max_keys) {
+	if (!raw_input_mode) {
+		return 0;
+	}
+	if (use_input_thread) {
+		return pop_keys(keys, max_keys);
+	}
+	std::size_t n = 0;
+	while (n < max_keys) {
+		const key k = get_key(false);
+		if (k.special == key_enum::no_key_pressed) {
+			break;
+		}
+		keys[n++] = k;
+		if (k.special == key_enum::paste) { // the next paste would reuse the buffer
+			break;
 		}
-		result.regular.bytes[i] = itoc(c);
 	}
-	return result;
+	return n;
+}
+
+const std::string& pasted_text() {
+	return use_input_thread ? last_paste : decoder.pasted_text();
+}
+
+style_stack_view get_current_style_stack_view() {
+	if (cout_buf) {
+		return cout_buf->styles().view();
+	}
+	return thread_style_stack().view(); // empty unless tags were written with thread_local_styles
 }
 
 terminal_size estimate_terminal_size(const terminal_size& default_if_not_gettable) {
-	terminal_size result = default_if_not_gettable;
-	if (!stdout_redirected) {
+	if (stdout_redirected) {
+		return default_if_not_gettable;
+	}
+	if ((!sigwinch_handler_installed) || size_changed.exchange(false)) {
 		struct winsize w;
-		int ioctl_result = ::ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
-		std::cout << "ioctl returned " << ioctl_result << std::endl;
-		result.columns = w.ws_col;
-		result.rows = w.ws_row;
+		std::uint32_t size = 0;
+		if (::ioctl(STDOUT_FILENO, TIOCGWINSZ, &w) == 0) {
+			size = (static_cast<std::uint32_t>(w.ws_col) << 16u) | static_cast<std::uint32_t>(w.ws_row);
+		}
+		cached_size = size;
+	}
+	const std::uint32_t size = cached_size;
+	terminal_size result;
+	result.columns = static_cast<int>(size >> 16u);
+	result.rows = static_cast<int>(size & 0xFFFFu);
+	if ((result.columns == 0) || (result.rows == 0)) {
+		return default_if_not_gettable;
 	}
 	return result;
 }
 
+
+// What the program wrote to std::cout or with printf() before the first line written to stdout
+// stays in front of it (a header, say). Later, they aren't flushed for each line.
+std::once_flag stdout_flushed_for_lines;
+
+void write_atomically(int fd, const char* p, std::size_t n) {
+	if (fd == STDOUT_FILENO) {
+		std::call_once(stdout_flushed_for_lines, []() {
+			std::cout.flush();
+			flush_stdio();
+		});
+	}
+	if ((fd == STDOUT_FILENO) && stdout_writer) {
+		stdout_writer->write(p, n); // in one piece as well
+		return;
+	}
+	if (n <= PIPE_BUF) { // a single write(), which the kernel doesn't interleave with other short ones
+		write_short_line(fd, p, n);
+		return;
+	}
+	write_long_line(fd, p, n);
+}
+
+strip_mode output_strip_mode(int fd) {
+	return (fd == STDOUT_FILENO) ? stdout_strip : strip_mode::none;
+}
+
 }
 
 #endif
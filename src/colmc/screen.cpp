@@ -0,0 +1,179 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#include <iterator>
+#include <algorithm>
+#include <colmc/screen.h>
+#include <colmc/sequences.h>
+#include <colmc/output.h>
+
+using namespace colmc;
+
+namespace {
+
+constexpr terminal_size fallback_size{80, 25};
+
+terminal_size sanitized(terminal_size size) {
+	if ((size.columns <= 0) || (size.rows <= 0)) {
+		return fallback_size;
+	}
+	return size;
+}
+
+std::size_t utf8_length(char lead) {
+	const auto c = static_cast<unsigned char>(lead);
+	if ((c & 0xE0) == 0xC0) {
+		return 2;
+	}
+	if ((c & 0xF0) == 0xE0) {
+		return 3;
+	}
+	if ((c & 0xF8) == 0xF0) {
+		return 4;
+	}
+	return 1; // ASCII (or a broken sequence, which is taken byte by byte)
+}
+
+std::size_t glyph_length(const cell& c) {
+	std::size_t n = 0;
+	while ((n < sizeof(c.glyph)) && (c.glyph[n] != '\0')) {
+		++n;
+	}
+	return n;
+}
+
+// Collects the glyphs of the cells [from_x, to_x), so the cursor can be moved by writing
+// them again. Only possible if they have the active style and are short enough.
+bool redraw_bytes(const cell* row, int from_x, int to_x, const cell_style& active, char (&out)[max_motion_len], std::size_t& len) {
+	len = 0;
+	for (int x = from_x; x < to_x; ++x) {
+		const cell& c = row[x];
+		const auto glyph_len = glyph_length(c);
+		if ((c.style != active) || ((len + std::max(glyph_len, std::size_t{1})) > max_motion_len)) {
+			return false;
+		}
+		if (glyph_len > 0) {
+			std::memcpy(out + len, c.glyph, glyph_len);
+			len += glyph_len;
+		}
+		else {
+			out[len++] = ' '; // see present()
+		}
+	}
+	return true;
+}
+
+}
+
+namespace colmc {
+
+screen::screen()
+	:screen(estimate_terminal_size(fallback_size))
+{
+}
+
+screen::screen(terminal_size size) {
+	resize(size);
+}
+
+void screen::resize(terminal_size size) {
+	m_size = sanitized(size);
+	const auto num_cells = static_cast<std::size_t>(m_size.columns) * static_cast<std::size_t>(m_size.rows);
+	m_front.assign(num_cells, cell{});
+	m_back.assign(num_cells, cell{});
+	invalidate();
+}
+
+void screen::clear(cell_style style) {
+	cell blank;
+	blank.style = style;
+	std::fill(m_back.begin(), m_back.end(), blank);
+}
+
+int screen::print(int x, int y, const std::string& utf8_text, cell_style style) {
+	if ((y < 0) || (y >= m_size.rows)) {
+		return 0;
+	}
+	int num_written = 0;
+	std::size_t i = 0;
+	while ((i < utf8_text.size()) && (x < m_size.columns)) {
+		const auto len = std::min(utf8_length(utf8_text[i]), utf8_text.size() - i);
+		if (x >= 0) {
+			cell& c = at(x, y);
+			c = cell{};
+			std::memcpy(c.glyph, utf8_text.data() + i, len);
+			c.style = style;
+			++num_written;
+		}
+		i += len;
+		++x;
+	}
+	return num_written;
+}
+
+void screen::present() {
+	render();
+	if (!m_out.empty()) {
+		std::cout.flush(); // what the application wrote before stays in front
+		write_atomically(1, m_out.data(), m_out.size());
+	}
+}
+
+void screen::present(std::ostream& o) {
+	render();
+	if (!m_out.empty()) {
+		o.write(m_out.data(), static_cast<std::streamsize>(m_out.size()));
+		o.flush();
+	}
+}
+
+void screen::render() {
+	m_out.clear(); // keeps the capacity
+	auto out = std::back_inserter(m_out);
+	if (m_full_redraw) {
+		m_out += "\x1B[0m";
+		clear_screen(out);
+		std::fill(m_front.begin(), m_front.end(), cell{}); // the terminal is blank now
+		m_sgr.reset();
+		m_cursor.invalidate();
+		m_full_redraw = false;
+	}
+	const auto columns = static_cast<std::size_t>(m_size.columns);
+	for (int y = 0; y < m_size.rows; ++y) {
+		const cell* back_row = m_back.data() + static_cast<std::size_t>(y) * columns;
+		const cell* front_row = m_front.data() + static_cast<std::size_t>(y) * columns;
+		if (std::memcmp(back_row, front_row, columns * sizeof(cell)) == 0) {
+			continue; // fast path for unchanged rows
+		}
+		int x = 0;
+		while (x < m_size.columns) {
+			if (back_row[x] == front_row[x]) {
+				++x;
+				continue;
+			}
+			char redraw[max_motion_len];
+			std::size_t redraw_len = 0;
+			const bool can_redraw = (m_cursor.y() == y) && (m_cursor.x() < x) && (!m_sgr.has_pending_change()) &&
+			                        redraw_bytes(back_row, m_cursor.x(), x, m_sgr.requested(), redraw, redraw_len);
+			char motion[max_motion_len];
+			m_out.append(motion, m_cursor.move_to(motion, x, y, can_redraw ? redraw : nullptr, redraw_len));
+			const int run_begin = x;
+			while ((x < m_size.columns) && (back_row[x] != front_row[x])) { // the run of changed cells
+				const cell& c = back_row[x];
+				m_sgr.request(c.style);
+				char sgr[max_sgr_len];
+				m_out.append(sgr, m_sgr.commit(sgr));
+				const auto len = glyph_length(c);
+				if (len > 0) {
+					m_out.append(c.glyph, len);
+				}
+				else {
+					m_out += ' '; // keep the cursor in sync
+				}
+				++x;
+			}
+			m_cursor.advance(x - run_begin, m_size.columns); // at the border the terminal may or may not have wrapped
+		}
+	}
+	m_front = m_back;
+}
+
+}
@@ -0,0 +1,250 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#include <cstring>
+#include <colmc/sgr.h>
+
+using namespace colmc;
+
+namespace {
+
+enum part: std::uint8_t {
+	part_fore      = 1u,
+	part_back      = 2u,
+	part_intensity = 4u,
+	all_parts      = 7u
+};
+
+// Applies a tracked SGR parameter to style. Returns false for untracked parameters.
+bool apply(cell_style& style, std::uint8_t& changed_parts, int param) {
+	if ((param >= 30) && (param <= 37)) {
+		style.fore = static_cast<color>(param - 30);
+		changed_parts |= part_fore;
+		return true;
+	}
+	if ((param >= 40) && (param <= 47)) {
+		style.back = static_cast<color>(param - 40);
+		changed_parts |= part_back;
+		return true;
+	}
+	switch(param) {
+		case 0:  style = cell_style{}; changed_parts = all_parts; return true;
+		case 1:  style.intensity = intensity::bright; changed_parts |= part_intensity; return true;
+		case 2:  style.intensity = intensity::dim;    changed_parts |= part_intensity; return true;
+		case 22: style.intensity = intensity::normal; changed_parts |= part_intensity; return true;
+		case 39: style.fore = color::reset;           changed_parts |= part_fore; return true;
+		case 49: style.back = color::reset;           changed_parts |= part_back; return true;
+		default: break;
+	}
+	return false;
+}
+
+// Collects the parameters of one SGR sequence
+class sgr_writer {
+public:
+	void add(int param) {
+		if (m_len == 0) {
+			m_buf[m_len++] = '\x1B';
+			m_buf[m_len++] = '[';
+		}
+		else {
+			m_buf[m_len++] = ';';
+		}
+		if (param >= 10) {
+			m_buf[m_len++] = static_cast<char>('0' + (param / 10));
+		}
+		m_buf[m_len++] = static_cast<char>('0' + (param % 10));
+	}
+
+	void add_color(int base, color c) {
+		add(base + static_cast<int>(c));
+	}
+
+	std::size_t size() const {
+		return (m_len == 0) ? 0 : (m_len + 1u); // +1: final 'm'
+	}
+
+	char* write(char* out) {
+		if (m_len == 0) {
+			return out;
+		}
+		std::memcpy(out, m_buf, m_len);
+		out[m_len] = 'm';
+		return out + m_len + 1u;
+	}
+
+private:
+	char m_buf[max_sgr_len];
+	std::size_t m_len = 0;
+};
+
+}
+
+namespace colmc {
+
+bool sgr_tracker::request(const int* params, std::size_t n) {
+	cell_style style = m_requested;
+	std::uint8_t changed_parts = 0;
+	bool reset_requested = (n == 0); // ESC [ m is the same as ESC [ 0 m
+	if (reset_requested) {
+		style = cell_style{};
+		changed_parts = all_parts;
+	}
+	for (std::size_t i = 0; i < n; ++i) {
+		if (!apply(style, changed_parts, params[i])) {
+			return false;
+		}
+		if (params[i] == 0) {
+			reset_requested = true;
+		}
+	}
+	m_requested = style;
+	m_requested_keep &= static_cast<std::uint8_t>(~changed_parts);
+	if (reset_requested) {
+		m_requested_untracked = false;
+	}
+	return true;
+}
+
+bool sgr_tracker::needs_reset() const {
+	return (m_terminal_untracked && (!m_requested_untracked));
+}
+
+bool sgr_tracker::differs(std::uint8_t p) const {
+	if ((m_requested_keep & p) != 0) {
+		return false;
+	}
+	if ((m_terminal_unknown & p) != 0) {
+		return true;
+	}
+	switch (p) {
+		case part_fore: return (m_requested.fore != m_terminal.fore);
+		case part_back: return (m_requested.back != m_terminal.back);
+		default: break;
+	}
+	return (m_requested.intensity != m_terminal.intensity);
+}
+
+bool sgr_tracker::has_pending_change() const {
+	return needs_reset() || differs(part_fore) || differs(part_back) || differs(part_intensity);
+}
+
+char* sgr_tracker::commit(char* out) {
+	if (!has_pending_change()) {
+		return out;
+	}
+	// variant 1: only the differences
+	sgr_writer incremental;
+	if (differs(part_intensity)) {
+		const bool intensity_known = ((m_terminal_unknown & part_intensity) == 0);
+		switch (m_requested.intensity) {
+			case intensity::normal:
+				incremental.add(22);
+				break;
+			case intensity::bright:
+				if ((!intensity_known) || (m_terminal.intensity == intensity::dim)) {
+					incremental.add(22); // bright and dim are independent attributes on some terminals
+				}
+				incremental.add(1);
+				break;
+			case intensity::dim:
+				if ((!intensity_known) || (m_terminal.intensity == intensity::bright)) {
+					incremental.add(22);
+				}
+				incremental.add(2);
+				break;
+		}
+	}
+	if (differs(part_fore)) {
+		incremental.add_color(30, m_requested.fore);
+	}
+	if (differs(part_back)) {
+		incremental.add_color(40, m_requested.back);
+	}
+	// variant 2: reset and set everything that isn't the default
+	sgr_writer full;
+	const bool full_allowed = ((!m_requested_untracked) && (m_requested_keep == 0)); // a reset would lose things we don't know
+	if (full_allowed) {
+		full.add(0);
+		if (m_requested.intensity == intensity::bright) {
+			full.add(1);
+		}
+		else if (m_requested.intensity == intensity::dim) {
+			full.add(2);
+		}
+		if (m_requested.fore != color::reset) {
+			full.add_color(30, m_requested.fore);
+		}
+		if (m_requested.back != color::reset) {
+			full.add_color(40, m_requested.back);
+		}
+	}
+	if (full_allowed && (needs_reset() || (full.size() <= incremental.size()))) {
+		out = full.write(out);
+		m_terminal = m_requested;
+		m_terminal_unknown = 0;
+		m_terminal_untracked = false;
+		return out;
+	}
+	out = incremental.write(out);
+	const cell_style kept = m_terminal;
+	m_terminal = m_requested;
+	if ((m_requested_keep & part_fore) != 0) {
+		m_terminal.fore = kept.fore;
+	}
+	if ((m_requested_keep & part_back) != 0) {
+		m_terminal.back = kept.back;
+	}
+	if ((m_requested_keep & part_intensity) != 0) {
+		m_terminal.intensity = kept.intensity;
+	}
+	m_terminal_unknown &= m_requested_keep;
+	return out;
+}
+
+void sgr_tracker::pass_through(const int* params, std::size_t n) {
+	if (n == 0) {
+		reset();
+		return;
+	}
+	for (std::size_t i = 0; i < n; ++i) {
+		std::uint8_t changed_parts = 0;
+		const int param = params[i];
+		if (apply(m_terminal, changed_parts, param)) {
+			m_terminal_unknown &= static_cast<std::uint8_t>(~changed_parts);
+			if (param == 0) {
+				m_terminal_untracked = false;
+			}
+		}
+		else if ((param == 38) || (param == 48)) { // extended colors: 38;5;n or 38;2;r;g;b
+			m_terminal_unknown |= (param == 38) ? part_fore : part_back;
+			if (((i + 1u) < n) && (params[i + 1u] == 5)) {
+				i += 2u;
+			}
+			else if (((i + 1u) < n) && (params[i + 1u] == 2)) {
+				i += 4u;
+			}
+		}
+		else {
+			m_terminal_untracked = true;
+		}
+	}
+	// the sequence was wanted as it is
+	m_requested = m_terminal;
+	m_requested_keep = m_terminal_unknown;
+	m_requested_untracked = m_terminal_untracked;
+}
+
+void sgr_tracker::invalidate() {
+	m_terminal_unknown = all_parts;
+	m_terminal_untracked = true;
+}
+
+void sgr_tracker::reset() {
+	m_terminal = cell_style{};
+	m_terminal_unknown = 0;
+	m_terminal_untracked = false;
+	m_requested = m_terminal;
+	m_requested_keep = 0;
+	m_requested_untracked = false;
+}
+
+}
@@ -0,0 +1,84 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#include <cstring>
+#include <colmc/algorithms.h>
+#include <colmc/sgr_filter.h>
+
+namespace colmc {
+
+// Writes everything but the SGR sequences as it comes from vt_tokenizer, after the pending
+// SGR change
+struct sgr_filter::handler: vt_handler {
+	sgr_filter& filter;
+	std::vector<char>& out;
+
+	handler(sgr_filter& f, std::vector<char>& o)
+		:filter(f)
+		,out(o)
+	{
+	}
+
+	void text(const char* p, std::size_t n) {
+		filter.commit(out);
+		out.insert(out.end(), p, p + n);
+	}
+
+	void sequence(const vt_sequence& seq) {
+		if ((seq.kind == vt_kind::csi) && (seq.final == 'm') && (seq.private_marker == '\0') && (seq.num_intermediates == 0)) {
+			filter.handle_sgr(seq, out);
+			return;
+		}
+		filter.commit(out); // other sequences (like cursor movement or clear screen) just need the right colors
+		out.insert(out.end(), seq.raw_data(), seq.raw_data() + seq.raw_len);
+	}
+
+	void string_begin(const vt_sequence& seq) {
+		filter.commit(out);
+		out.insert(out.end(), seq.raw_data(), seq.raw_data() + seq.raw_len);
+	}
+
+	void string_data(const char* p, std::size_t n) {
+		out.insert(out.end(), p, p + n);
+	}
+
+	void string_end(vt_string_end end) {
+		const char* terminator = string_terminator(end);
+		out.insert(out.end(), terminator, terminator + std::strlen(terminator));
+	}
+};
+
+void sgr_filter::commit(std::vector<char>& out) {
+	char buf[max_sgr_len];
+	const char* end = m_tracker.commit(buf);
+	out.insert(out.end(), static_cast<const char*>(buf), end);
+}
+
+void sgr_filter::handle_sgr(const vt_sequence& seq, std::vector<char>& out) {
+	if (seq.malformed || seq.has_subparams) { // more params than fit, or colors like 38:2::255:0:0
+		commit(out);
+		out.insert(out.end(), seq.raw_data(), seq.raw_data() + seq.raw_len);
+		m_tracker.invalidate();
+		return;
+	}
+	int params[vt_sequence::max_params];
+	for (std::size_t i = 0; i < seq.num_params; ++i) {
+		params[i] = static_cast<int>(seq.params[i]);
+	}
+	if (!m_tracker.request(params, seq.num_params)) {
+		commit(out);
+		out.insert(out.end(), seq.raw_data(), seq.raw_data() + seq.raw_len);
+		m_tracker.pass_through(params, seq.num_params);
+	}
+}
+
+void sgr_filter::filter(const char* p, std::size_t n, std::vector<char>& out) {
+	handler h{*this, out};
+	m_tokenizer.feed(p, n, h);
+}
+
+void sgr_filter::finish(std::vector<char>& out) {
+	handler h{*this, out};
+	m_tokenizer.finish(h); // an incomplete sequence is text
+	commit(out);
+}
+
+}
@@ -0,0 +1,41 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#ifndef colmc_sgr_filter_h_INCLUDED
+#define colmc_sgr_filter_h_INCLUDED
+
+#include <cstddef>
+#include <vector>
+#include <colmc/sgr.h>
+#include <colmc/vt_tokenizer.h>
+
+namespace colmc {
+
+//! \brief Copies text and escape sequences while dropping SGR sequences that change nothing
+//! and merging adjacent ones into a single sequence (see sgr_tracker). SGR changes are
+//! written right before the next text or non-SGR sequence. The sequences are taken by
+//! vt_tokenizer, so they may be split at any position between the calls of filter(), whatever
+//! their length; strings (like OSC) are written with the terminator they had.
+class sgr_filter {
+public:
+	void filter(const char* p, std::size_t n, std::vector<char>& out);
+
+	//! \brief Writes the pending SGR change and a kept back incomplete sequence to out
+	void finish(std::vector<char>& out);
+
+	//! \brief true if filter() would not simply copy text without escape sequences
+	bool has_pending() const {
+		return (!m_tokenizer.in_ground()) || m_tracker.has_pending_change();
+	}
+
+private:
+	struct handler;
+
+	void handle_sgr(const vt_sequence& seq, std::vector<char>& out);
+	void commit(std::vector<char>& out);
+
+	sgr_tracker m_tracker;
+	vt_tokenizer m_tokenizer;
+};
+
+}
+
+#endif
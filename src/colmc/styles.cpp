@@ -0,0 +1,439 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <colmc/setup.h>
+#include <colmc/styles.h>
+
+using namespace colmc;
+
+namespace {
+
+constexpr char reset_sequence[] = "\x1B[0m";
+
+// FNV-1a; the names are short, so this is cheaper than std::hash
+std::size_t hash_name(std::string_view name) {
+	std::uint32_t hash = 2166136261u;
+	for (const char c : name) {
+		hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+	}
+	return hash;
+}
+
+std::atomic<const style_snapshot*> current_snapshot{nullptr}; // nullptr: no style registered yet
+std::mutex registry_mutex; // serializes add_style() and remove_style()
+std::atomic<bool> thread_local_style_stacks{false};
+
+const style_snapshot& empty_snapshot() {
+	static const auto* empty = new style_snapshot; // never destroyed: used by teardown() at exit
+	return *empty;
+}
+
+// The names of style_snapshot, which stay valid when the snapshots are freed (see
+// style_stack_view). Only added to while holding registry_mutex.
+const std::string* intern_name(const std::string& name) {
+	static auto* names = new std::deque<std::string>; // never destroyed, see above
+	names->push_back(name);
+	return &names->back();
+}
+
+// Hazard pointers: each thread reading the registry has a slot holding the snapshot it uses
+// (see style_snapshot_guard). The slots are never freed; those of ended threads are reused.
+struct hazard_slot {
+	std::atomic<const style_snapshot*> snapshot{nullptr};
+	std::atomic<bool> in_use{true};
+	hazard_slot* next = nullptr;
+};
+
+std::atomic<hazard_slot*> hazard_slots{nullptr};
+
+hazard_slot* acquire_hazard_slot() {
+	for (hazard_slot* slot = hazard_slots.load(std::memory_order_acquire); slot != nullptr; slot = slot->next) {
+		bool in_use = false;
+		if (slot->in_use.compare_exchange_strong(in_use, true)) {
+			return slot;
+		}
+	}
+	auto* slot = new hazard_slot;
+	slot->next = hazard_slots.load(std::memory_order_relaxed);
+	while (!hazard_slots.compare_exchange_weak(slot->next, slot, std::memory_order_release, std::memory_order_relaxed)) {
+	}
+	return slot;
+}
+
+// Trivially destructible, so that guards still work after the thread's destructors ran (in
+// the destructors of static objects at exit)
+thread_local hazard_slot* this_thread_slot = nullptr;
+thread_local std::size_t this_thread_guards = 0;
+
+struct hazard_slot_releaser {
+	~hazard_slot_releaser() {
+		if (this_thread_slot != nullptr) {
+			this_thread_slot->snapshot.store(nullptr, std::memory_order_release);
+			this_thread_slot->in_use.store(false, std::memory_order_release);
+			this_thread_slot = nullptr;
+		}
+	}
+};
+
+hazard_slot& this_thread_hazard_slot() {
+	if (this_thread_slot == nullptr) {
+		thread_local hazard_slot_releaser releaser;
+		this_thread_slot = acquire_hazard_slot();
+	}
+	return *this_thread_slot;
+}
+
+// The replaced snapshots that readers may still use. Only used while holding registry_mutex.
+std::vector<const style_snapshot*>& retired_snapshots() {
+	static auto* retired = new std::vector<const style_snapshot*>; // never destroyed, see above
+	return *retired;
+}
+
+// Frees the retired snapshots that aren't in any hazard slot
+void free_unused_snapshots() {
+	std::vector<const style_snapshot*>& retired = retired_snapshots();
+	std::vector<const style_snapshot*> used;
+	for (hazard_slot* slot = hazard_slots.load(std::memory_order_acquire); slot != nullptr; slot = slot->next) {
+		const style_snapshot* snapshot = slot->snapshot.load(); // seq_cst, see style_snapshot_guard
+		if (snapshot != nullptr) {
+			used.push_back(snapshot);
+		}
+	}
+	const auto end = std::remove_if(retired.begin(), retired.end(), [&used](const style_snapshot* snapshot) {
+		if (std::find(used.begin(), used.end(), snapshot) != used.end()) {
+			return false;
+		}
+		delete snapshot;
+		return true;
+	});
+	retired.erase(end, retired.end());
+}
+
+// Publishes a copy of the current snapshot modified by change. Readers may still use the old
+// snapshot, so it is retired and freed once no hazard slot holds it.
+// The caller holds registry_mutex.
+template<typename Change>
+bool publish_changed_snapshot(Change change) {
+	const style_snapshot* old_snapshot = current_snapshot.load(std::memory_order_relaxed);
+	auto* snapshot = new style_snapshot((old_snapshot != nullptr) ? *old_snapshot : empty_snapshot());
+	if (!change(*snapshot)) {
+		delete snapshot;
+		return false;
+	}
+	current_snapshot.store(snapshot); // seq_cst, so that the hazard slots read below are up to date
+	if (old_snapshot != nullptr) {
+		retired_snapshots().push_back(old_snapshot);
+	}
+	free_unused_snapshots();
+	return true;
+}
+
+// output of style_tag_rewriter::rewrite_to(): text() is called for chars of the input,
+// copy() for everything else
+struct copying_sink {
+	std::vector<char>& out;
+
+	void text(const char* p, std::size_t n) {
+		out.insert(out.end(), p, p + n);
+	}
+
+	void copy(const char* p, std::size_t n) {
+		out.insert(out.end(), p, p + n);
+	}
+};
+
+struct piece_sink {
+	std::vector<output_piece>& out;
+	std::string& sequences;
+
+	void text(const char* p, std::size_t n) {
+		if ((!out.empty()) && (out.back().text != nullptr) && ((out.back().text + out.back().size) == p)) {
+			out.back().size += n; // continues the last piece
+		}
+		else if (n > 0) {
+			out.push_back(output_piece{p, 0, n});
+		}
+	}
+
+	void copy(const char* p, std::size_t n) {
+		if ((!out.empty()) && (out.back().text == nullptr)) {
+			out.back().size += n; // the last piece ends at the end of sequences
+		}
+		else if (n > 0) {
+			out.push_back(output_piece{nullptr, sequences.size(), n});
+		}
+		sequences.append(p, n);
+	}
+};
+
+}
+
+namespace colmc {
+
+style_id style_snapshot::find(std::string_view name) const {
+	const style_id id = find_interned(name);
+	return ((id != invalid_style_id) && m_styles[id].defined) ? id : invalid_style_id;
+}
+
+style_id style_snapshot::find_interned(std::string_view name) const {
+	if (m_slots.empty()) {
+		return invalid_style_id;
+	}
+	const std::size_t mask = m_slots.size() - 1u;
+	for (std::size_t i = hash_name(name) & mask; ; i = (i + 1u) & mask) { // never full
+		const style_id id = m_slots[i];
+		if ((id == invalid_style_id) || (*m_styles[id].name == name)) {
+			return id;
+		}
+	}
+}
+
+void style_snapshot::set(const std::string& name, const std::string& sequence) {
+	style_id id = find_interned(name);
+	if (id == invalid_style_id) {
+		id = static_cast<style_id>(m_styles.size());
+		m_styles.push_back(style{intern_name(name), std::string{}, false});
+		rehash();
+	}
+	m_styles[id].reset_and_sequence = reset_sequence + sequence;
+	m_styles[id].defined = true;
+}
+
+bool style_snapshot::remove(std::string_view name) {
+	const style_id id = find(name);
+	if (id == invalid_style_id) {
+		return false;
+	}
+	m_styles[id].reset_and_sequence = reset_sequence; // see sequence()
+	m_styles[id].defined = false;
+	return true;
+}
+
+void style_snapshot::rehash() {
+	std::size_t num_slots = 8u;
+	while (num_slots < (2u * m_styles.size())) { // at most half full
+		num_slots *= 2u;
+	}
+	m_slots.assign(num_slots, invalid_style_id);
+	const std::size_t mask = num_slots - 1u;
+	for (style_id id = 0; id < m_styles.size(); ++id) {
+		std::size_t i = hash_name(*m_styles[id].name) & mask;
+		while (m_slots[i] != invalid_style_id) {
+			i = (i + 1u) & mask;
+		}
+		m_slots[i] = id;
+	}
+}
+
+style_snapshot_guard::style_snapshot_guard() {
+	hazard_slot& slot = this_thread_hazard_slot();
+	if (this_thread_guards++ > 0) { // nested: the outer guard protects the snapshot
+		m_snapshot = slot.snapshot.load(std::memory_order_relaxed);
+	}
+	else {
+		// publish the snapshot, then check that it wasn't replaced (and maybe freed) before
+		// add_style() or remove_style() could see it
+		const style_snapshot* snapshot = current_snapshot.load(std::memory_order_acquire);
+		const style_snapshot* published = nullptr;
+		do {
+			published = snapshot;
+			slot.snapshot.store(published); // seq_cst, pairs with publish_changed_snapshot()
+			snapshot = current_snapshot.load();
+		} while (snapshot != published);
+		m_snapshot = published;
+	}
+	if (m_snapshot == nullptr) { // no style registered yet
+		m_snapshot = &empty_snapshot();
+	}
+}
+
+style_snapshot_guard::~style_snapshot_guard() {
+	if (--this_thread_guards == 0) {
+		this_thread_slot->snapshot.store(nullptr, std::memory_order_release);
+	}
+}
+
+std::size_t num_retired_snapshots() {
+	std::unique_lock<std::mutex> lock{registry_mutex};
+	return retired_snapshots().size();
+}
+
+style_stack_view style_stack::view() const {
+	style_stack_view result;
+	result.m_size = (m_depth < capacity) ? m_depth : capacity;
+	for (std::size_t i = 0; i < result.m_size; ++i) {
+		result.m_ids[i] = m_ids[i];
+		if (m_ids[i] == invalid_style_id) {
+			std::memcpy(result.m_unknown_names[i], m_unknown_names[i], m_unknown_name_lens[i]);
+			result.m_unknown_name_lens[i] = m_unknown_name_lens[i];
+		}
+	}
+	return result;
+}
+
+std::string_view style_stack_view::operator[](std::size_t i) const {
+	if (m_ids[i] == invalid_style_id) { // unknown styles aren't interned
+		return std::string_view{m_unknown_names[i], m_unknown_name_lens[i]};
+	}
+	const style_snapshot_guard guard;
+	return guard.styles().name(m_ids[i]); // the names are interned until the end of the program
+}
+
+style_stack& thread_style_stack() {
+	thread_local style_stack stack;
+	return stack;
+}
+
+void use_thread_local_style_stacks(bool enable) {
+	thread_local_style_stacks = enable;
+}
+
+std::string_view resolve_style_tag(const style_snapshot& styles, const char* tag, std::size_t len, style_stack& stack) {
+	assert(len >= 3u);
+	assert(tag[0] == '<');
+	assert(tag[len-1] == '>');
+	const bool is_end_style = (tag[1] == '/');
+	if (!is_end_style) {
+		const std::string_view name{tag + 1, len - 2};
+		const style_id id = styles.find(name);
+		stack.push(id, name);
+		if (id == invalid_style_id) {
+			return std::string_view{}; // don't change style for unknown styles
+		}
+		return styles.reset_and_sequence(id);
+	}
+	stack.pop();
+	if (stack.top() != invalid_style_id) {
+		return styles.reset_and_sequence(stack.top()); // restore last style (only the reset if it was removed)
+	}
+	return std::string_view{reset_sequence, sizeof(reset_sequence) - 1u};
+}
+
+style_stack& style_tag_rewriter::stack() {
+	return thread_local_style_stacks.load(std::memory_order_relaxed) ? thread_style_stack() : m_stack;
+}
+
+template<typename Sink>
+void style_tag_rewriter::rewrite_to(const char* p, std::size_t n, Sink& out) {
+	const style_snapshot_guard guard; // the sequences are only copied to out
+	style_stack& styles = stack();
+	if ((m_pending_size > 0u) && (!complete_pending(p, n, guard.styles(), styles, out))) {
+		return; // still not complete
+	}
+	while (n > 0) {
+		const std::size_t pos = count_until(p, n, '<');
+		if (pos == n) {
+			out.text(p, n);
+			break; // all style tags handled, job finished
+		}
+		out.text(p, pos);
+		p += pos;
+		n -= pos;
+		const std::size_t end = find_end_of_style_sequence(p, n);
+		if (end != invalid_end_of_sequence) {
+			const std::string_view sequence = resolve_style_tag(guard.styles(), p, end, styles);
+			out.copy(sequence.data(), sequence.size());
+			p += end;
+			n -= end;
+		}
+		else if (is_style_sequence_prefix(p, n)) { // cut off by the end of the buffer
+			std::memcpy(m_pending, p, n);
+			m_pending_size = n;
+			break;
+		}
+		else { // it wasn't a sequence but a regular '<' inside text...
+			out.text(p, 1u);
+			++p;
+			--n;
+		}
+	}
+}
+
+// Tries to complete the tag kept back by the previous call with the beginning of [p, p + n).
+// Returns false if [p, p + n) is too short to decide.
+template<typename Sink>
+bool style_tag_rewriter::complete_pending(const char*& p, std::size_t& n, const style_snapshot& styles, style_stack& stack, Sink& out) {
+	char combined[2u * max_style_seq_len];
+	const std::size_t taken = std::min(n, max_style_seq_len);
+	std::memcpy(combined, m_pending, m_pending_size);
+	std::memcpy(combined + m_pending_size, p, taken);
+	const std::size_t combined_size = m_pending_size + taken;
+	const std::size_t end = find_end_of_style_sequence(combined, combined_size);
+	if (end != invalid_end_of_sequence) {
+		assert(end > m_pending_size); // the pending part never contains the '>'
+		const std::string_view sequence = resolve_style_tag(styles, combined, end, stack);
+		out.copy(sequence.data(), sequence.size());
+		p += (end - m_pending_size);
+		n -= (end - m_pending_size);
+		m_pending_size = 0;
+		return true;
+	}
+	if (is_style_sequence_prefix(combined, combined_size)) {
+		assert(taken == n);
+		std::memcpy(m_pending, combined, combined_size);
+		m_pending_size = combined_size;
+		p += taken;
+		n -= taken;
+		return false;
+	}
+	// the pending part was regular text; the '<' is the only one in it, so
+	// [p, p + n) can be scanned from the beginning
+	out.copy(m_pending, m_pending_size);
+	m_pending_size = 0;
+	return true;
+}
+
+void style_tag_rewriter::rewrite(const char* p, std::size_t n, std::vector<char>& out) {
+	copying_sink sink{out};
+	rewrite_to(p, n, sink);
+}
+
+void style_tag_rewriter::rewrite(const char* p, std::size_t n, std::vector<output_piece>& out) {
+	m_sequences.clear(); // keeps the capacity
+	piece_sink sink{out, m_sequences};
+	rewrite_to(p, n, sink);
+}
+
+void style_tag_rewriter::finish(std::vector<char>& out) {
+	out.insert(out.end(), m_pending, m_pending + m_pending_size);
+	m_pending_size = 0;
+}
+
+bool add_style(const std::string& tag_name, const std::string& escape_sequence) {
+	for (const auto c: tag_name) {
+		if (!(((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')) || (c == '_'))) {
+			return false;
+		}
+	}
+	std::unique_lock<std::mutex> lock{registry_mutex};
+	return publish_changed_snapshot([&](style_snapshot& styles) {
+		if (styles.find(tag_name) != invalid_style_id) { // already exists
+			return false;
+		}
+		styles.set(tag_name, escape_sequence);
+		return true;
+	});
+}
+
+bool remove_style(const std::string& tag_name) {
+	std::unique_lock<std::mutex> lock{registry_mutex};
+	return publish_changed_snapshot([&](style_snapshot& styles) {
+		return styles.remove(tag_name);
+	});
+}
+
+std::string get_style(const std::string& tag_name) {
+	const style_snapshot_guard guard;
+	const style_id id = guard.styles().find(tag_name);
+	return (id != invalid_style_id) ? std::string{guard.styles().sequence(id)} : std::string{};
+}
+
+std::vector<std::string> get_current_style_stack() {
+	return get_current_style_stack_view(); // the stack is platform specific
+}
+
+}
@@ -0,0 +1,208 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#ifndef colmc_styles_h_INCLUDED
+#define colmc_styles_h_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <colmc/setup.h>
+#include <colmc/algorithms.h>
+
+// Internal part of the style support that is shared by the platform specific
+// stream buffers. The public part is declared in <colmc/setup.h>.
+// Each stream (style_tag_rewriter) has a style stack of its own, or each thread with
+// config::thread_local_styles, so streams and threads don't change each other's styles.
+
+namespace colmc {
+
+//! \brief Small integer a style name is interned to. The ID of a name never changes, even if
+//! the style is removed and added again.
+using style_id = std::uint32_t;
+
+constexpr style_id invalid_style_id = 0xFFFFFFFFu; //!< for names that aren't registered
+
+//! \brief Immutable state of the style registry. add_style() and remove_style() publish a
+//! modified copy; readers use the current one (see style_snapshot_guard) without any lock.
+class style_snapshot {
+public:
+	//! \brief Allocation free lookup
+	//! \returns invalid_style_id if there is no such style
+	style_id find(std::string_view name) const;
+
+	//! \brief The escape sequence of the style with the ID id (from find())
+	std::string_view sequence(style_id id) const {
+		return std::string_view{m_styles[id].reset_and_sequence}.substr(reset_sequence_len);
+	}
+
+	//! \brief The reset sequence followed by the escape sequence of the style, which replaces
+	//! the tags that switch to the style
+	std::string_view reset_and_sequence(style_id id) const {
+		return m_styles[id].reset_and_sequence;
+	}
+
+	//! \brief The name of the style with the ID id. Also valid after the style was removed,
+	//! and after the snapshot was freed: the names are interned until the end of the program.
+	const std::string& name(style_id id) const {
+		return *m_styles[id].name;
+	}
+
+	//! \brief Interns the name if needed and sets the sequence of its style
+	void set(const std::string& name, const std::string& sequence);
+
+	//! \brief Removes the style, but not the interned name
+	bool remove(std::string_view name);
+
+private:
+	static constexpr std::size_t reset_sequence_len = 4u; // ESC [ 0 m
+
+	struct style {
+		const std::string* name;
+		std::string reset_and_sequence;
+		bool defined = false;
+	};
+
+	style_id find_interned(std::string_view name) const;
+	void rehash();
+
+	std::vector<style> m_styles;      // index: style_id
+	std::vector<style_id> m_slots;    // open addressing hash table of the IDs; size: power of 2
+};
+
+//! \brief Keeps the current state of the registry from being freed while the guard exists.
+//! The snapshot is published as a hazard pointer of the calling thread, which add_style() and
+//! remove_style() check before they free a replaced snapshot. Guards of the same thread may be
+//! nested; the inner ones use the snapshot of the outermost.
+class style_snapshot_guard {
+public:
+	style_snapshot_guard();
+	~style_snapshot_guard();
+	style_snapshot_guard(const style_snapshot_guard&) = delete;
+	style_snapshot_guard& operator=(const style_snapshot_guard&) = delete;
+
+	const style_snapshot& styles() const {
+		return *m_snapshot;
+	}
+
+private:
+	const style_snapshot* m_snapshot;
+};
+
+//! \brief The number of replaced snapshots that aren't freed yet because a reader may still use
+//! them (for tests)
+std::size_t num_retired_snapshots();
+
+//! \brief The styles in effect, innermost last. The capacity is fixed, so pushing and popping
+//! never allocates. Tags nested deeper than the capacity are only counted, so that their end
+//! tags still match.
+class style_stack {
+public:
+	static constexpr std::size_t capacity = style_stack_view::max_size;
+
+	//! \param name of the tag, only kept if id is invalid_style_id (see style_stack_view)
+	void push(style_id id, std::string_view name) {
+		if (m_depth < capacity) {
+			m_ids[m_depth] = id;
+			if (id == invalid_style_id) {
+				const std::size_t len = (name.size() < style_stack_view::max_name_len) ? name.size() : style_stack_view::max_name_len;
+				std::memcpy(m_unknown_names[m_depth], name.data(), len);
+				m_unknown_name_lens[m_depth] = static_cast<std::uint8_t>(len);
+			}
+		}
+		++m_depth;
+	}
+
+	void pop() {
+		if (m_depth > 0) {
+			--m_depth;
+		}
+	}
+
+	bool empty() const {
+		return (m_depth == 0);
+	}
+
+	//! \returns invalid_style_id if empty or nested too deep to know
+	style_id top() const {
+		return ((m_depth > 0) && (m_depth <= capacity)) ? m_ids[m_depth - 1u] : invalid_style_id;
+	}
+
+	void clear() {
+		m_depth = 0;
+	}
+
+	style_stack_view view() const;
+
+private:
+	style_id m_ids[capacity];
+	char m_unknown_names[capacity][style_stack_view::max_name_len];
+	std::uint8_t m_unknown_name_lens[capacity];
+	std::size_t m_depth = 0;
+};
+
+static_assert(style_stack_view::max_name_len >= (max_style_seq_len - 1u), "the name of every style tag fits");
+
+//! \brief The style stack of the calling thread (config::thread_local_styles)
+style_stack& thread_style_stack();
+
+//! \brief Makes all style_tag_rewriters use thread_style_stack() instead of their own stack
+void use_thread_local_style_stacks(bool enable);
+
+//! \brief Translates the complete style tag [tag, tag + len) ("<name>" or "</>") into
+//! the escape sequence replacing it and pushes/pops the style stack. Takes no lock and
+//! doesn't copy anything: the result refers to styles (see style_snapshot_guard).
+std::string_view resolve_style_tag(const style_snapshot& styles, const char* tag, std::size_t len, style_stack& stack);
+
+//! \brief A piece of the output of style_tag_rewriter::rewrite() that doesn't copy the text:
+//! either [text, text + size) or, if text is nullptr, size chars at offset within
+//! style_tag_rewriter::sequences()
+struct output_piece {
+	const char* text;
+	std::size_t offset;
+	std::size_t size;
+};
+
+//! \brief Replaces the style tags inside a stream of text by escape sequences.
+//! The text is processed in a single forward pass. A tag that is cut off at the end of
+//! one call of rewrite() is kept back and completed by the next call.
+class style_tag_rewriter {
+public:
+	//! \brief Appends the rewritten [p, p + n) to out
+	void rewrite(const char* p, std::size_t n, std::vector<char>& out);
+
+	//! \brief Like above, but appends the pieces of the output instead of copying it. The
+	//! pieces refer to [p, p + n) and to sequences(), which is replaced by the next call.
+	void rewrite(const char* p, std::size_t n, std::vector<output_piece>& out);
+
+	//! \brief The escape sequences (and the chars of kept back tags) of the pieces
+	const std::string& sequences() const {
+		return m_sequences;
+	}
+
+	//! \brief Appends a kept back incomplete tag as plain text to out
+	void finish(std::vector<char>& out);
+
+	bool has_pending() const {
+		return (m_pending_size > 0u);
+	}
+
+	//! \brief The stack of this rewriter or of the calling thread (use_thread_local_style_stacks())
+	style_stack& stack();
+
+private:
+	template<typename Sink>
+	void rewrite_to(const char* p, std::size_t n, Sink& out);
+	template<typename Sink>
+	bool complete_pending(const char*& p, std::size_t& n, const style_snapshot& styles, style_stack& stack, Sink& out);
+
+	char m_pending[max_style_seq_len];
+	std::size_t m_pending_size = 0;
+	style_stack m_stack;
+	std::string m_sequences; // kept as member to avoid repetitive allocations
+};
+
+}
+
+#endif
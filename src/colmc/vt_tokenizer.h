@@ -0,0 +1,463 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#ifndef colmc_vt_tokenizer_h_INCLUDED
+#define colmc_vt_tokenizer_h_INCLUDED
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <colmc/algorithms.h>
+
+namespace colmc {
+
+enum class vt_kind : std::uint8_t {
+	esc, //!< ESC [intermediates] final, e.g. ESC 7 (save cursor)
+	csi, //!< ESC [ [private marker] [params] [intermediates] final, e.g. colors and cursor movement
+	ss3, //!< ESC O final
+	osc, //!< ESC ] string, e.g. the window title or a hyperlink
+	dcs, //!< ESC P [private marker] [params] [intermediates] final string
+	sos, //!< ESC X string
+	pm,  //!< ESC ^ string
+	apc  //!< ESC _ string
+};
+
+//! \brief How a string (OSC, DCS, ...) ended
+enum class vt_string_end : std::uint8_t {
+	cancelled, //!< by CAN, SUB, ESC (not followed by '\\') or the end of the output
+	st,        //!< by ST (ESC \\)
+	bel        //!< by BEL (only OSC)
+};
+
+//! \brief The bytes that ended a string, to write it again as it was ("" if it was cancelled)
+inline const char* string_terminator(vt_string_end end) {
+	switch (end) {
+		case vt_string_end::st:
+			return "\x1B\\";
+		case vt_string_end::bel:
+			return "\a";
+		case vt_string_end::cancelled:
+			break;
+	}
+	return "";
+}
+
+//! \brief An escape sequence as reported by vt_tokenizer. For the string kinds (OSC, DCS, ...)
+//! it only describes the introducer; the string itself is reported in pieces.
+struct vt_sequence {
+	static constexpr std::size_t max_params = 16u;
+	static constexpr std::size_t max_intermediates = 2u;
+	static constexpr std::size_t max_raw_len = 64u;
+
+	vt_kind kind = vt_kind::esc;
+	char private_marker = '\0'; //!< one of < = > ? right after ESC [ or ESC P
+	char final = '\0';
+	bool malformed = false;     //!< a byte the sequence doesn't allow, or more params or intermediates than fit
+	bool has_subparams = false; //!< params are separated by ':' (like 38:2::255:0:0)
+	std::uint8_t num_params = 0;
+	std::uint8_t num_intermediates = 0;
+	char intermediates[max_intermediates] = {};
+	std::uint32_t params[max_params] = {}; //!< empty params are 0
+	char raw[max_raw_len] = {};            //!< the bytes of the sequence if it fits (only the introducer for the string kinds)
+	std::size_t raw_len = 0;               //!< the number of bytes of the sequence, whatever its length
+	const char* long_raw = nullptr;        //!< the bytes if there are more than max_raw_len (owned by the tokenizer)
+
+	//! \brief The i-th param, default_value if it is missing or 0 (as most sequences treat it)
+	std::uint32_t param(std::size_t i, std::uint32_t default_value) const {
+		return ((i < num_params) && (params[i] != 0)) ? params[i] : default_value;
+	}
+
+	//! \brief The bytes of the sequence (raw_len of them)
+	const char* raw_data() const {
+		return (long_raw != nullptr) ? long_raw : raw;
+	}
+};
+
+//! \brief Handler with nothing to do, to be derived from. A handler of vt_tokenizer has these
+//! member functions (only the ones that are used need to be shadowed):
+struct vt_handler {
+	//! \brief Text outside of sequences. Control chars (like '\n') are text as well; inside of
+	//! a sequence they are reported right away, like a terminal executes them there.
+	void text(const char*, std::size_t) {}
+	//! \brief A complete ESC, CSI or SS3 sequence
+	void sequence(const vt_sequence&) {}
+	//! \brief The start of an OSC, DCS (after its final byte), SOS, PM or APC string
+	void string_begin(const vt_sequence&) {}
+	//! \brief A piece of the string
+	void string_data(const char*, std::size_t) {}
+	//! \brief The end of the string and how it ended
+	void string_end(vt_string_end) {}
+};
+
+//! \brief Splits output into text and escape sequences following the state machine of DEC's
+//! VT500 terminals (see https://vt100.net/emu/dec_ansi_parser), with ':' in params and the BEL
+//! that ends OSC strings as xterm understands them. The state is kept between the calls of
+//! feed(), so sequences may be split at any position. Text is found with the vectorized scan
+//! for ESC and reported as spans of the input; only the bytes of sequences are looked at one by
+//! one. Nothing is allocated, but for the bytes of sequences longer than vt_sequence::max_raw_len
+//! (the buffer is kept for the next one). Bytes from 0x80 are text (UTF-8), not 8 bit control chars.
+class vt_tokenizer {
+public:
+	template<typename Handler>
+	void feed(const char* p, std::size_t n, Handler& handler) {
+		while (n > 0) {
+			if (m_state == state::ground) {
+				const std::size_t text = count_until_esc(p, n);
+				if (text > 0) {
+					handler.text(p, text);
+					p += text;
+					n -= text;
+					if (n == 0) {
+						break;
+					}
+				}
+			}
+			const std::size_t taken = feed_sequence(p, n, handler);
+			p += taken;
+			n -= taken;
+		}
+	}
+
+	//! \brief Like feed(), but only takes the bytes up to the end of the sequence (or string)
+	//! that starts at p[0], an ESC, or that the tokenizer is inside of. For callers that scan
+	//! the text themselves.
+	//! \returns the number of bytes taken
+	template<typename Handler>
+	std::size_t feed_sequence(const char* p, std::size_t n, Handler& handler) {
+		const char* const begin = p;
+		if ((n > 0) && (m_state == state::ground)) {
+			assert(p[0] == esc);
+			start_sequence();
+			const std::size_t taken = 1u + fast_csi(p + 1, n - 1u, handler);
+			p += taken;
+			n -= taken;
+		}
+		while ((n > 0) && (m_state != state::ground)) {
+			if (m_state == state::string) {
+				std::size_t i = 0;
+				while ((i < n) && (!ends_string(static_cast<unsigned char>(p[i])))) {
+					++i;
+				}
+				if (i > 0) {
+					handler.string_data(p, i);
+					p += i;
+					n -= i;
+					if (n == 0) {
+						break;
+					}
+				}
+			}
+			step(p, handler);
+			++p;
+			--n;
+		}
+		return static_cast<std::size_t>(p - begin);
+	}
+
+	//! \brief Call at the end of the output: an incomplete sequence is reported as text, an
+	//! unterminated string is ended
+	template<typename Handler>
+	void finish(Handler& handler) {
+		if ((m_state == state::string) || (m_state == state::string_esc)) {
+			handler.string_end(vt_string_end::cancelled);
+		}
+		else if (m_state != state::ground) {
+			handler.text(m_seq.raw_data(), m_seq.raw_len);
+		}
+		m_state = state::ground;
+	}
+
+	//! \brief Forgets an incomplete sequence or string (the buffer for long ones is kept)
+	void reset() {
+		m_state = state::ground;
+	}
+
+	//! \brief true if the tokenizer isn't inside a sequence or string
+	bool in_ground() const {
+		return (m_state == state::ground);
+	}
+
+private:
+	enum class state : std::uint8_t {
+		ground,
+		escape,
+		escape_intermediate,
+		entry,        // of CSI or DCS, right after ESC [ or ESC P
+		param,        // of CSI or DCS
+		intermediate, // of CSI or DCS
+		ignore,       // rest of a malformed CSI or DCS
+		ss3,
+		string,
+		string_esc    // ESC inside of a string, normally the start of ST (ESC \)
+	};
+
+	static constexpr unsigned char can = 0x18;
+	static constexpr unsigned char sub = 0x1A;
+	static constexpr unsigned char bel = 0x07;
+	static constexpr std::uint32_t max_param_value = 0xFFFFu;
+
+	static bool is_intermediate(unsigned char c) {
+		return ((c >= 0x20) && (c <= 0x2F));
+	}
+
+	static bool is_final(unsigned char c) {
+		return ((c >= 0x40) && (c <= 0x7E));
+	}
+
+	bool ends_string(unsigned char c) const {
+		return (c == static_cast<unsigned char>(esc)) || (c == can) || (c == sub) || ((c == bel) && (m_seq.kind == vt_kind::osc));
+	}
+
+	void start_sequence() {
+		m_seq.kind = vt_kind::esc;
+		m_seq.private_marker = '\0';
+		m_seq.final = '\0';
+		m_seq.malformed = false;
+		m_seq.has_subparams = false;
+		m_seq.num_params = 0;
+		m_seq.num_intermediates = 0;
+		m_seq.raw[0] = esc;
+		m_seq.raw_len = 1u;
+		m_seq.long_raw = nullptr;
+		m_state = state::escape;
+	}
+
+	void add_raw(char c) {
+		if (m_seq.raw_len < vt_sequence::max_raw_len) {
+			m_seq.raw[m_seq.raw_len] = c;
+		}
+		else {
+			if (m_seq.raw_len == vt_sequence::max_raw_len) { // moves to m_long_raw
+				m_long_raw.assign(m_seq.raw, m_seq.raw + vt_sequence::max_raw_len);
+			}
+			m_long_raw.push_back(c);
+			m_seq.long_raw = m_long_raw.data();
+		}
+		++m_seq.raw_len;
+	}
+
+	void add_intermediate(char c) {
+		if (m_seq.num_intermediates < vt_sequence::max_intermediates) {
+			m_seq.intermediates[m_seq.num_intermediates++] = c;
+		}
+		else {
+			m_seq.malformed = true;
+		}
+	}
+
+	void add_param_char(unsigned char c) {
+		if (m_seq.num_params == 0) {
+			m_seq.params[0] = 0;
+			m_seq.num_params = 1u;
+		}
+		if ((c == ';') || (c == ':')) {
+			m_seq.has_subparams = m_seq.has_subparams || (c == ':');
+			if (m_seq.num_params < vt_sequence::max_params) {
+				m_seq.params[m_seq.num_params++] = 0;
+			}
+			else {
+				m_seq.malformed = true;
+			}
+			return;
+		}
+		std::uint32_t& value = m_seq.params[m_seq.num_params - 1u];
+		value = (value * 10u) + (c - '0');
+		if (value > max_param_value) { // no sequence takes values that big
+			value = max_param_value;
+		}
+	}
+
+	template<typename Handler>
+	void begin_string(vt_kind kind, Handler& handler) {
+		m_seq.kind = kind;
+		m_state = state::string;
+		handler.string_begin(m_seq);
+	}
+
+	template<typename Handler>
+	void dispatch(char final, Handler& handler) {
+		m_seq.final = final;
+		if (m_seq.kind == vt_kind::dcs) {
+			begin_string(vt_kind::dcs, handler);
+			return;
+		}
+		m_state = state::ground;
+		handler.sequence(m_seq);
+	}
+
+	// Takes the common CSI sequences (like colors) in one go if they are complete in [p, p + n),
+	// which starts after the ESC: only params and the final byte. Returns the number of bytes
+	// taken, 0 to leave them to step() (which starts over after the ESC).
+	template<typename Handler>
+	std::size_t fast_csi(const char* p, std::size_t n, Handler& handler) {
+		if ((n < 2u) || (p[0] != '[')) {
+			return 0;
+		}
+		const std::size_t max_len = std::min(n, vt_sequence::max_raw_len - 1u); // ESC is in raw
+		std::size_t i = 1u;
+		for (; i < max_len; ++i) {
+			const auto c = static_cast<unsigned char>(p[i]);
+			if (((c >= '0') && (c <= '9')) || (c == ';') || (c == ':')) {
+				add_param_char(c);
+			}
+			else {
+				break;
+			}
+		}
+		if ((i == max_len) || (!is_final(static_cast<unsigned char>(p[i]))) || m_seq.malformed) {
+			m_seq.num_params = 0;
+			m_seq.has_subparams = false;
+			m_seq.malformed = false;
+			return 0;
+		}
+		m_seq.kind = vt_kind::csi;
+		std::memcpy(m_seq.raw + 1, p, i + 1u);
+		m_seq.raw_len = i + 2u;
+		dispatch(p[i], handler);
+		return i + 1u;
+	}
+
+	// handles the byte at p inside of a sequence or a string
+	template<typename Handler>
+	void step(const char* p, Handler& handler) {
+		const auto c = static_cast<unsigned char>(*p);
+		if (m_state == state::string_esc) {
+			handler.string_end((c == '\\') ? vt_string_end::st : vt_string_end::cancelled);
+			if (c == '\\') { // ST
+				m_state = state::ground;
+				return;
+			}
+			start_sequence(); // the ESC starts the next sequence
+		}
+		else if (m_state == state::string) { // one of the chars that end a string
+			if (c == static_cast<unsigned char>(esc)) {
+				m_state = state::string_esc;
+				return;
+			}
+			handler.string_end((c == bel) ? vt_string_end::bel : vt_string_end::cancelled);
+			m_state = state::ground;
+			if (c != bel) {
+				handler.text(p, 1u); // CAN or SUB
+			}
+			return;
+		}
+		if (c == static_cast<unsigned char>(esc)) { // cancels the sequence and starts the next one
+			start_sequence();
+			return;
+		}
+		if (c < 0x20) {
+			handler.text(p, 1u); // executed right away, CAN and SUB cancel the sequence too
+			if ((c == can) || (c == sub)) {
+				m_state = state::ground;
+			}
+			return;
+		}
+		if (c == 0x7F) { // DEL is ignored
+			return;
+		}
+		add_raw(static_cast<char>(c));
+		switch (m_state) {
+			case state::escape:
+				if (is_intermediate(c)) {
+					add_intermediate(static_cast<char>(c));
+					m_state = state::escape_intermediate;
+				}
+				else if (c == '[') {
+					m_seq.kind = vt_kind::csi;
+					m_state = state::entry;
+				}
+				else if (c == 'P') {
+					m_seq.kind = vt_kind::dcs;
+					m_state = state::entry;
+				}
+				else if (c == 'O') {
+					m_seq.kind = vt_kind::ss3;
+					m_state = state::ss3;
+				}
+				else if (c == ']') {
+					begin_string(vt_kind::osc, handler);
+				}
+				else if (c == 'X') {
+					begin_string(vt_kind::sos, handler);
+				}
+				else if (c == '^') {
+					begin_string(vt_kind::pm, handler);
+				}
+				else if (c == '_') {
+					begin_string(vt_kind::apc, handler);
+				}
+				else {
+					m_seq.malformed = (c >= 0x80);
+					dispatch(static_cast<char>(c), handler);
+				}
+				break;
+			case state::escape_intermediate:
+				if (is_intermediate(c)) {
+					add_intermediate(static_cast<char>(c));
+				}
+				else {
+					m_seq.malformed = m_seq.malformed || (c >= 0x80);
+					dispatch(static_cast<char>(c), handler);
+				}
+				break;
+			case state::entry:
+				if ((c >= 0x3C) && (c <= 0x3F)) {
+					m_seq.private_marker = static_cast<char>(c);
+					m_state = state::param;
+					break;
+				}
+				// fall through
+			case state::param:
+				if (((c >= '0') && (c <= '9')) || (c == ';') || (c == ':')) {
+					add_param_char(c);
+					m_state = state::param;
+				}
+				else if (is_intermediate(c)) {
+					add_intermediate(static_cast<char>(c));
+					m_state = state::intermediate;
+				}
+				else if (is_final(c)) {
+					dispatch(static_cast<char>(c), handler);
+				}
+				else { // a private marker after the params or a byte from 0x80
+					m_seq.malformed = true;
+					m_state = state::ignore;
+				}
+				break;
+			case state::intermediate:
+				if (is_intermediate(c)) {
+					add_intermediate(static_cast<char>(c));
+				}
+				else if (is_final(c)) {
+					dispatch(static_cast<char>(c), handler);
+				}
+				else {
+					m_seq.malformed = true;
+					m_state = state::ignore;
+				}
+				break;
+			case state::ignore:
+				if (is_final(c)) {
+					dispatch(static_cast<char>(c), handler);
+				}
+				break;
+			case state::ss3:
+				m_seq.malformed = (c >= 0x80);
+				dispatch(static_cast<char>(c), handler);
+				break;
+			case state::ground:
+			case state::string:
+			case state::string_esc:
+				break;
+		}
+	}
+
+	vt_sequence m_seq;
+	std::vector<char> m_long_raw; // the bytes of m_seq if they don't fit into its raw
+	state m_state = state::ground;
+};
+
+}
+
+#endif
@@ -9,10 +9,10 @@
 #include <iostream>
 #include <cstdlib>
 #include <vector>
-#include <unordered_map>
 #include <memory>
-#include <mutex>
+#include <chrono>
 #include <cassert>
+#include <mutex>
 #include <Windows.h>
 #include <io.h> 
 #include <fcntl.h>
@@ -21,6 +21,9 @@
 #include <colmc/raw_input.h>
 #include <colmc/term_size.h>
 #include <colmc/algorithms.h>
+#include <colmc/styles.h>
+#include <colmc/output.h>
+#include <colmc/vt_tokenizer.h>
 
 using namespace colmc;
 
@@ -29,14 +32,12 @@ namespace {
 constexpr std::size_t min_buf_size = 16u;
 constexpr std::size_t parsed_params_capacity = 4u;
 constexpr std::size_t default_buf_size = 256u;
-constexpr std::size_t buf_growth = 256u;
 bool is_setup = false;
 bool stdout_redirected = false;
 bool win_utf8 = false;
 bool allow_styles = false;
 int old_cin_mode = -1;
 int old_cout_mode = -1;
-std::unique_ptr<std::basic_streambuf<char>> cout_buf;
 std::unique_ptr<std::basic_streambuf<char>> cin_buf;
 std::basic_streambuf<char>* old_cout_buf = nullptr;
 std::basic_streambuf<char>* old_cin_buf = nullptr;
@@ -44,9 +45,7 @@ HANDLE h_console = nullptr;
 CONSOLE_SCREEN_BUFFER_INFO initial_console_settings;
 DWORD old_console_mode = 0;
 bool raw_input_mode = false;
-std::unordered_map<std::string, std::string> styles;
-std::vector<std::string> style_stack;
-std::mutex style_mutex;
+std::mutex write_mutex; // see write_atomically()
 
 bool is_stdout_redirected() {
 	DWORD temp;
@@ -60,8 +59,9 @@ public:
 	using base = std::basic_streambuf<char>;
 	virtual ~ostreambuf() {}
 	
-	explicit ostreambuf(std::size_t buf_size)
+	explicit ostreambuf(std::size_t buf_size, bool rewrite_styles = true)
 		:m_buf(buf_size, '\0')
+		,m_rewrite_styles(rewrite_styles)
 	{
 		m_previous_text_attributes = initial_console_settings.wAttributes;
 		if (buf_size < min_buf_size) {
@@ -71,6 +71,27 @@ public:
 		reset_region();
 	}
 
+	style_stack& styles() {
+		return m_rewriter.stack();
+	}
+
+	// for text whose style tags are already resolved (like the lines of log_sink): only its
+	// escape sequences are translated, after what is still buffered
+	void write_translated(const char* p, std::size_t n) {
+		sync();
+		handle(p, n);
+	}
+
+	// outputs everything including an incomplete style tag or escape sequence at the end
+	void finish() {
+		sync();
+		m_rewritten.clear();
+		m_rewriter.finish(m_rewritten);
+		handle(m_rewritten.data(), m_rewritten.size());
+		console_handler handler{*this};
+		m_tokenizer.finish(handler);
+	}
+
 protected:
 
 	// derived classes implement it for std::wcout and std::cout forwarding
@@ -81,8 +102,8 @@ protected:
 	}
 
 	// called in case the buffer is too small before a flush()/std::endl call.
-	// Calls should be very rare because a terminal line length is restricted
-	// and the default buf size should be sufficient for most cases.
+	// Calls should be rare because a terminal line length is restricted
+	// and the buffer grows geometrically, so it quickly fits the longest line.
 	int_type overflow(int_type ch = std::char_traits<char>::eof()) override {
 		if (ch == std::char_traits<char>::eof()) {
 			return ch;
@@ -90,7 +111,7 @@ protected:
 		const auto next_char = static_cast<char>(ch);
 		m_buf.back() = next_char;
 		const std::size_t old_size = m_buf.size();
-		m_buf.resize(old_size + buf_growth); // make buffer bigger
+		m_buf.resize(old_size * 2u); // make buffer bigger
 		// give client new write area in the new space, leaving one byte for the next overflow
 		base::setp(m_buf.data() + old_size, m_buf.data() + m_buf.size() - 1u);
 		return 0;
@@ -99,7 +120,23 @@ protected:
 	// called when data should appear on screen. This is where escape sequences are filtered
 	// and handled specially
 	int sync() override {
-		handle(static_cast<std::size_t>(pptr() - m_buf.data()));
+		const auto num_of_chars = static_cast<std::size_t>(pptr() - m_buf.data());
+		const bool rewrite_styles = allow_styles && m_rewrite_styles;
+		std::size_t plain = 0;
+		if ((!m_rewriter.has_pending()) && m_tokenizer.in_ground()) { // one scan for both, escape sequences and style tags
+			plain = rewrite_styles ? count_until_either(m_buf.data(), num_of_chars, esc, '<') : count_until_esc(m_buf.data(), num_of_chars);
+		}
+		if (plain == num_of_chars) {
+			output(m_buf.data(), num_of_chars); // fast path: nothing to translate
+		}
+		else if (rewrite_styles) {
+			m_rewritten.clear(); // keeps the capacity
+			m_rewriter.rewrite(m_buf.data(), num_of_chars, m_rewritten);
+			handle(m_rewritten.data(), m_rewritten.size());
+		}
+		else {
+			handle(m_buf.data(), num_of_chars);
+		}
 		reset_region();
 		return 0;
 	}
@@ -108,138 +145,40 @@ protected:
 		base::setp(m_buf.data(), m_buf.data() + m_buf.size() - 1u); // -1u so that overflow() can put the next char before handle()
 	}
 
-	void handleStyleTags(std::size_t& num_of_chars) {
-		std::unique_lock<std::mutex> lock{style_mutex};
-		std::size_t n = num_of_chars;
-		std::size_t i = 0;
-		while(n > 0) {
-			const char* p = m_buf.data() + i;
-			const std::size_t pos = index_of(p, '<', n);
-			if (pos == no_pos) {
-				break; // all style tags handled, job finished
-			}
-			const std::size_t remaining = (n - pos);
-			if (remaining < 3) { // 3: minimum a '<', then a single char or '/', then '>
-				i += (pos + 1);
-				n -= (pos + 1);
-				continue;
-			}
-			std::size_t end = find_end_of_style_sequence(p + pos, remaining);
-			if (end == invalid_end_of_sequence) { // it wasn't a sequence but a regular '>' or '<' inside text...
-				i += (pos + 1);
-				n -= (pos + 1);
-				continue;
-			}
-			end += pos; // convert relative end to absolute end
-			assert(p[pos] == '<');
-			assert(p[end-1] == '>');
-			// [pos, end) is the range of the style tag
-			const bool is_end_style = ((end-pos) > 2) && (p[pos+1] == '/');
-			std::string sequence = "\x1B[0m"; // reset style sequence
-			if (!is_end_style) {
-				const auto key = std::string{p + pos + 1, end - pos - 2 };
-				const auto style = styles.find(key);
-				if (style == styles.end()) {
-					sequence = ""; // don't change style for unknown styles
-				}
-				else
-				{
-					sequence += style->second;
-				}
-				style_stack.push_back(key);
-			}
-			else {
-				if (!style_stack.empty()) {
-					style_stack.resize(style_stack.size() - 1u); // pop off stack
-				}
-				if (!style_stack.empty()) {
-					sequence += styles[style_stack.back()]; // restore last style
-				}
-			}
-			const auto num_of_chars_before = num_of_chars;
-			colmc::replace_content(m_buf, num_of_chars, i + pos, end-pos, sequence.c_str(), sequence.size(), buf_growth);
-			if (num_of_chars > num_of_chars_before) {
-				n += (num_of_chars - num_of_chars_before);
-			}
-			else {
-				n -= (num_of_chars_before - num_of_chars);
-			}
-			i += (pos + sequence.size()); // continue searching after the pasted sequence in m_buf
-			n -= (pos + sequence.size());
+	// forwards the text and the sequences the console understands to it
+	struct console_handler : vt_handler {
+		explicit console_handler(ostreambuf& b)
+			:buf(b)
+		{
 		}
-	}
 
-	void handle(std::size_t num_of_chars) {
-		if (allow_styles) {
-			handleStyleTags(num_of_chars);
+		void text(const char* p, std::size_t n) {
+			buf.output(p, n);
 		}
-		const char* begin = m_buf.data();
-		while (num_of_chars > 0) {
-			std::size_t n = count_until_esc(begin, num_of_chars);
-			if (n > 0) {
-				output(begin, n);
-				begin += n;
-				num_of_chars -= n;
-			}
-			if (num_of_chars == 0) {
-				break;
-			}
-			if (begin[0] == esc) {
-				if ((num_of_chars > 2u) && (begin[1] == '[')) {
-					n = find_end_of_esc_sequence(begin, num_of_chars);
-					if (n == invalid_end_of_sequence) {
-						// output the invalid sequence so at least it is obvious that it's wrong
-						output(begin, n);
-						begin += n;
-						num_of_chars -= n;
-						continue;
-					}
-					if (!handle_esc_sequence(begin, n)) {
-						// something is wrong with the sequence
-						output(begin, n);
-					}
-					begin += n;
-					num_of_chars -= n;
-					continue;
-				}
-				// else:
-				output(esc);
-				++begin;
-				--num_of_chars;
-				continue;
+
+		void sequence(const vt_sequence& s) {
+			if ((s.kind == vt_kind::csi) && buf.handle_esc_sequence(s)) {
+				return;
 			}
-			assert(false); // line shouldn't be reached
-			output(begin[0]);
-			++begin;
-			--num_of_chars;
-			continue;
+			buf.output(s.raw_data(), s.raw_len); // output the sequence (whatever its length) so at least it is obvious that it's wrong
 		}
+
+		ostreambuf& buf; // strings (like window titles of OSC sequences) are dropped
+	};
+
+	void handle(const char* begin, std::size_t num_of_chars) {
+		console_handler handler{*this};
+		m_tokenizer.feed(begin, num_of_chars, handler);
 	}
 
-	bool handle_esc_sequence(const char* p, std::size_t n) {
+	bool handle_esc_sequence(const vt_sequence& s) {
+		if ((s.private_marker != '\0') || (s.num_intermediates > 0u) || s.malformed || s.has_subparams) {
+			return false;
+		}
+		const char command = s.final;
 		m_parsed_params.resize(0);
-		assert(n > 3u);
-		p += 2u; // after esc [
-		n -= 2u;
-		const char command = p[n-1];
-		n--; // don't need to parse that any more
-		while(n > 0) { // rest is parameters
-			if (p[0] == ';') { // param separator
-				++p;
-				--n;
-				continue;
-			}
-			char* end_ptr = nullptr;
-			const int param = static_cast<int>(std::strtol(p, &end_ptr, 10));
-			if (end_ptr > p) { // number parsed successfully
-				const auto num_parsed = static_cast<std::size_t>(end_ptr - p);
-				m_parsed_params.push_back(param);
-				p += num_parsed;
-				n -= num_parsed;
-			}
-			else {
-				return false;
-			}
+		for (std::size_t i = 0; i < s.num_params; ++i) {
+			m_parsed_params.push_back(static_cast<int>(s.params[i]));
 		}
 		if (m_parsed_params.empty()) {
 			m_parsed_params.push_back(0); // when no params specified, the default is zero
@@ -481,7 +420,11 @@ protected:
 
 	std::vector<char> m_buf;
 	std::vector<int> m_parsed_params; // kept as member to avoid repetitive allocations
+	std::vector<char> m_rewritten; // kept as member to avoid repetitive allocations
+	style_tag_rewriter m_rewriter;
+	vt_tokenizer m_tokenizer; // keeps a sequence that is split between two flushes
 	WORD m_previous_text_attributes = 0;
+	bool m_rewrite_styles = true;
 };
 
 class ostreambuf_to_wcout: public ostreambuf {
@@ -540,6 +483,21 @@ protected:
 	}
 };
 
+// For the lines of log_sink to stderr: their style tags are already resolved, only the
+// escape sequences are translated
+class ostreambuf_to_cerr: public ostreambuf {
+public:
+	explicit ostreambuf_to_cerr(std::size_t buf_size)
+		:ostreambuf(buf_size, false)
+	{}
+
+protected:
+	void output(const char* p, std::size_t n) override {
+		std::cerr.write(p, static_cast<std::streamsize>(n));
+		std::cerr.flush();
+	}
+};
+
 class istreambuf: public std::basic_streambuf<char> {
 public:
 	using base = std::basic_streambuf<char>;
@@ -577,6 +535,63 @@ protected:
 	}
 };
 
+std::unique_ptr<ostreambuf> cout_buf;
+std::unique_ptr<ostreambuf> cerr_buf; // see write_atomically()
+bool stderr_is_console = false;
+
+key_enum function_key(std::wint_t n) {
+	return static_cast<key_enum>(static_cast<int>(key_enum::f1) + static_cast<int>(n));
+}
+
+// Translates the scan code _getwch() returns after a 0 or 224
+key translate_scan_code(std::wint_t code) {
+	key result;
+	result.special = key_enum::unknown;
+	if ((code >= 59) && (code <= 68)) { // F1-F10
+		result.special = function_key(code - 59);
+		return result;
+	}
+	if ((code >= 84) && (code <= 113)) { // F1-F10 with SHIFT, CTRL or ALT
+		const std::uint8_t modifiers[] = { modifier::shift, modifier::ctrl, modifier::alt };
+		result.special = function_key((code - 84) % 10);
+		result.modifiers = modifiers[(code - 84) / 10];
+		return result;
+	}
+	if ((code >= 133) && (code <= 140)) { // F11, F12: plain, SHIFT, CTRL, ALT
+		const std::uint8_t modifiers[] = { modifier::none, modifier::shift, modifier::ctrl, modifier::alt };
+		result.special = function_key(10 + ((code - 133) % 2));
+		result.modifiers = modifiers[(code - 133) / 2];
+		return result;
+	}
+	struct entry {
+		std::wint_t code;
+		key_enum special;
+		std::uint8_t modifiers;
+	};
+	static const entry table[] = {
+		{ 71, key_enum::home, modifier::none }, { 72, key_enum::up, modifier::none }, { 73, key_enum::page_up, modifier::none },
+		{ 75, key_enum::left, modifier::none }, { 77, key_enum::right, modifier::none }, { 79, key_enum::end, modifier::none },
+		{ 80, key_enum::down, modifier::none }, { 81, key_enum::page_down, modifier::none }, { 82, key_enum::insert, modifier::none },
+		{ 83, key_enum::del, modifier::none },
+		{ 119, key_enum::home, modifier::ctrl }, { 141, key_enum::up, modifier::ctrl }, { 132, key_enum::page_up, modifier::ctrl },
+		{ 115, key_enum::left, modifier::ctrl }, { 116, key_enum::right, modifier::ctrl }, { 117, key_enum::end, modifier::ctrl },
+		{ 145, key_enum::down, modifier::ctrl }, { 118, key_enum::page_down, modifier::ctrl }, { 146, key_enum::insert, modifier::ctrl },
+		{ 147, key_enum::del, modifier::ctrl },
+		{ 151, key_enum::home, modifier::alt }, { 152, key_enum::up, modifier::alt }, { 153, key_enum::page_up, modifier::alt },
+		{ 155, key_enum::left, modifier::alt }, { 157, key_enum::right, modifier::alt }, { 159, key_enum::end, modifier::alt },
+		{ 160, key_enum::down, modifier::alt }, { 161, key_enum::page_down, modifier::alt }, { 162, key_enum::insert, modifier::alt },
+		{ 163, key_enum::del, modifier::alt }
+	};
+	for (const auto& e : table) {
+		if (e.code == code) {
+			result.special = e.special;
+			result.modifiers = e.modifiers;
+			break;
+		}
+	}
+	return result;
+}
+
 }
 
 namespace colmc {
@@ -590,6 +605,8 @@ void setup(config cfg) {
 	win_utf8 = cfg.win_utf8;
 	h_console = ::GetStdHandle(STD_OUTPUT_HANDLE);
 	stdout_redirected = is_stdout_redirected();
+	DWORD stderr_mode;
+	stderr_is_console = (::GetConsoleMode(::GetStdHandle(STD_ERROR_HANDLE), &stderr_mode) != 0);
 	if (!stdout_redirected) {
 		if (cfg.raw_input_mode) {
 			::GetConsoleMode(h_console, &old_console_mode);
@@ -611,7 +628,11 @@ void setup(config cfg) {
 			cout_buf = std::make_unique<ostreambuf_to_cout>(default_buf_size);
 			old_cout_buf = std::cout.rdbuf(cout_buf.get());
 		}
+		if (stderr_is_console) { // most likely the same console, so the attributes can be set on h_console
+			cerr_buf = std::make_unique<ostreambuf_to_cerr>(default_buf_size);
+		}
 		allow_styles = cfg.allow_styles;
+		use_thread_local_style_stacks(cfg.thread_local_styles);
 	}
 	std::atexit(teardown);
 	is_setup = true;
@@ -623,11 +644,18 @@ void teardown() {
 		if (old_cin_buf != nullptr) {
 			std::cin.rdbuf(old_cin_buf);
 		}
+		if (cout_buf) {
+			cout_buf->finish();
+		}
+		if (cerr_buf) {
+			cerr_buf->finish();
+		}
 		if (old_cout_buf != nullptr) {
 			std::cout.rdbuf(old_cout_buf);
 		}
 		cin_buf.reset();
 		cout_buf.reset();
+		cerr_buf.reset();
 		old_cin_buf = nullptr;
 		old_cout_buf = nullptr;
 		if (win_utf8) {
@@ -640,8 +668,10 @@ void teardown() {
 		::SetConsoleMode(h_console, old_console_mode);
 	}
 	allow_styles = false;
+	use_thread_local_style_stacks(false);
 	h_console = nullptr;
 	stdout_redirected = false;
+	stderr_is_console = false;
 	raw_input_mode = false;
 	is_setup = false;
 }
@@ -663,40 +693,78 @@ key get_key(bool block_until_pressed) {
 	}
 	std::cout.flush();
 	const std::wint_t ch = ::_getwch();
-	if ((ch == 0) || (ch == 1)) { // happens with the F1-F12 keys or with CTRL
-		result.special = key_enum::unknown;
-		return result;
+	if ((ch == 0) || (ch == 224)) { // special keys like the arrows and F1-F12 come with a scan code
+		return translate_scan_code(::_getwch());
 	}
-	if (ch != 224) // no special character
-	{
-		result.special = key_enum::regular;
-		auto wc = static_cast<wchar_t>(ch);
-		if (wc == L'\r') {
-			wc = L'\n'; // because ENTER is translated into LF on posix rather than CR on Windows...
-		}
-		const auto num = ::WideCharToMultiByte(CP_UTF8, 0, &wc, 1, result.regular.bytes, 4u, nullptr, nullptr);
-		assert((num > 0) && (num <= 4));
-		result.regular.bytes[num] = '\0';
-	}
-	else  {
-		const std::wint_t control_char = ::_getwch();
-		switch(control_char) {
-			case 71: result.special = key_enum::home; break;
-			case 72: result.special = key_enum::up; break;
-			case 73: result.special = key_enum::page_up; break;
-			case 75: result.special = key_enum::left; break;
-			case 77: result.special = key_enum::right; break;
-			case 79: result.special = key_enum::end; break;
-			case 80: result.special = key_enum::down; break;
-			case 81: result.special = key_enum::page_down; break;
-			case 82: result.special = key_enum::insert; break;
-			case 83: result.special = key_enum::del; break;
-			default: result.special = key_enum::unknown; break;
-		}
+	result.special = key_enum::regular;
+	auto wc = static_cast<wchar_t>(ch);
+	if (wc == L'\r') {
+		wc = L'\n'; // because ENTER is translated into LF on posix rather than CR on Windows...
 	}
+	const auto num = ::WideCharToMultiByte(CP_UTF8, 0, &wc, 1, result.regular.bytes, 4u, nullptr, nullptr);
+	assert((num > 0) && (num <= 4));
+	result.regular.bytes[num] = '\0';
 	return result;
 }
 
+key get_key(std::chrono::milliseconds timeout) {
+	if (!raw_input_mode) {
+		return {};
+	}
+	const auto end = std::chrono::steady_clock::now() + timeout;
+	const HANDLE h_input = ::GetStdHandle(STD_INPUT_HANDLE);
+	for (;;) {
+		if (::_kbhit()) {
+			return get_key(true);
+		}
+		// events that are no key presses (like key releases or focus changes) would wake us up again and again
+		INPUT_RECORD record;
+		DWORD num_events = 0;
+		if (::PeekConsoleInputW(h_input, &record, 1, &num_events) && (num_events == 1) &&
+		    ((record.EventType != KEY_EVENT) || (!record.Event.KeyEvent.bKeyDown))) {
+			::ReadConsoleInputW(h_input, &record, 1, &num_events);
+			continue;
+		}
+		const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(end - std::chrono::steady_clock::now()).count();
+		if (remaining <= 0) {
+			return {};
+		}
+		::WaitForSingleObject(h_input, static_cast<DWORD>(remaining));
+	}
+}
+
+const std::string& pasted_text() {
+	static const std::string empty; // no bracketed paste with _getwch()
+	return empty;
+}
+
+int input_fd() {
+	return -1; // console handles can't be polled like file descriptors
+}
+
+std::size_t read_keys(key* keys, std::size_t max_keys) {
+	return poll_keys(keys, max_keys);
+}
+
+std::size_t poll_keys(key* keys, std::size_t max_keys) {
+	std::size_t n = 0;
+	while ((n < max_keys) && key_pressed()) {
+		keys[n++] = get_key(false);
+	}
+	return n;
+}
+
+void flush_and_wait() {
+	std::cout.flush(); // output is always synchronous here
+}
+
+style_stack_view get_current_style_stack_view() {
+	if (cout_buf) {
+		return cout_buf->styles().view();
+	}
+	return thread_style_stack().view(); // empty unless tags were written with thread_local_styles
+}
+
 terminal_size estimate_terminal_size(const terminal_size& default_if_not_gettable) {
 	terminal_size result = default_if_not_gettable;
 	if (h_console != nullptr) {
@@ -708,43 +776,25 @@ terminal_size estimate_terminal_size(const terminal_size& default_if_not_gettabl
 	return result;
 }
 
-bool add_style(const std::string& tag_name, const std::string& escape_sequence) {
-	for (const auto c: tag_name) {
-		if (!(((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')) || (c == '_'))) {
-			return false;
-		}
-	}
-	std::unique_lock<std::mutex> lock{style_mutex};
-	if (styles.find(tag_name) != styles.end()) { // already exists
-		return false;
-	}
-	styles[tag_name] = escape_sequence;
-	return true;
-}
 
-bool remove_style(const std::string& tag_name) {
-	std::unique_lock<std::mutex> lock{style_mutex};
-	const auto style = styles.find(tag_name);
-	if (style != styles.end()) {
-		styles.erase(style);
-		return true;
-	}
-	return false;
-}
-std::string get_style(const std::string& tag_name) {
-	std::unique_lock<std::mutex> lock{style_mutex};
-	std::string result;
-	const auto style = styles.find(tag_name);
-	if (style != styles.end()) {
-		result = style->second;
+// The console colors are global state, so the lines can only be written one by one. They
+// don't go through std::cout, whose cout_buf would take a '<' in the text for a style tag.
+void write_atomically(int fd, const char* p, std::size_t n) {
+	std::lock_guard<std::mutex> lock{write_mutex};
+	ostreambuf* console_buf = (fd == 2) ? cerr_buf.get() : cout_buf.get();
+	if (console_buf != nullptr) {
+		console_buf->write_translated(p, n);
+		return;
 	}
-	return result;
+	std::ostream& o = (fd == 2) ? std::cerr : std::cout; // redirected, nothing to translate
+	o.write(p, static_cast<std::streamsize>(n));
+	o.flush();
 }
 
-std::vector<std::string> get_current_style_stack() {
-	std::unique_lock<std::mutex> lock{style_mutex};
-	std::vector<std::string> result = style_stack;
-	return result;
+strip_mode output_strip_mode(int fd) {
+	// config::strip_sequences is POSIX only, but a console showing stderr without the
+	// translation of cerr_buf (stdout is redirected) would print the sequences literally
+	return ((fd == 2) && stderr_is_console && (!cerr_buf)) ? strip_mode::all : strip_mode::none;
 }
 
 }
@@ -0,0 +1,395 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <colmc/version.h>
+#include <colmc/setup.h>
+#include <colmc/sequences.h>
+#include <colmc/colors.h>
+#include <colmc/screen.h>
+#include <colmc/algorithms.h>
+#include <colmc/styles.h>
+#include <colmc/key_decoder.h>
+#include <colmc/sgr_filter.h>
+#include <colmc/ansi_stripper.h>
+#include <colmc/vt_tokenizer.h>
+
+// Measures the hot paths of the output and the input and prints the results as JSON, so
+// that they can be compared between releases:
+//
+//   colmc_bench [filter] > results.json
+//
+// Only the benchmarks whose name contains filter are run. Each one is run once to warm up
+// and then several times; the fastest run counts, which makes the numbers repeatable on a
+// busy machine. The inputs are generated deterministically. The "baseline" entries are
+// former implementations, so the ratio to them doesn't depend on the machine.
+// Build in release mode for meaningful numbers.
+
+using namespace colmc;
+
+namespace {
+
+constexpr int repetitions = 7;
+
+struct result {
+	std::string name;
+	const char* unit;
+	double value;
+};
+
+std::vector<result> results;
+std::string filter;
+volatile std::size_t sink = 0; // keeps the compiler from optimizing the work away
+
+//! \brief Runs func (which does ops operations and returns a checksum) and records the best
+//! time per operation
+template<typename Func>
+void run(const std::string& name, const char* unit, double ops, Func&& func) {
+	if (name.find(filter) == std::string::npos) {
+		return;
+	}
+	sink = sink + func(); // warm up caches and buffers
+	double best = 0.0;
+	for (int r = 0; r < repetitions; ++r) {
+		const auto start = std::chrono::steady_clock::now();
+		sink = sink + func();
+		const auto stop = std::chrono::steady_clock::now();
+		const double ns = std::chrono::duration<double, std::nano>(stop - start).count() / ops;
+		if ((r == 0) || (ns < best)) {
+			best = ns;
+		}
+	}
+	results.push_back(result{name, unit, best});
+}
+
+//! \brief Records the last result once more, per item instead of per operation
+void add_per_item(const std::string& name, const char* unit, double ops, double items) {
+	if ((!results.empty()) && (items > 0.0) && (results.back().name.find(filter) != std::string::npos)) {
+		results.push_back(result{name, unit, results.back().value * ops / items});
+	}
+}
+
+// colored log lines: text with an SGR sequence and a style tag every few dozen bytes
+std::string make_colored_lines(std::size_t size, bool with_tags) {
+	const std::string words = "The quick brown fox jumps over the lazy dog. ";
+	std::string text;
+	text.reserve(size + 128u);
+	for (std::size_t line = 0; text.size() < size; ++line) {
+		text += fore::red;
+		text += std::to_string(line);
+		text += reset_all;
+		text += ' ';
+		if (with_tags && ((line % 4u) == 0)) {
+			text += "<red>";
+			text += words;
+			text += "</>";
+		}
+		text += words;
+		text += words;
+		text += '\n';
+	}
+	return text;
+}
+
+// text with tags_per_kib pairs of style tags per KiB
+std::string make_tagged_text(std::size_t size, std::size_t tags_per_kib) {
+	const std::string plain = "The quick brown fox jumps over the lazy dog. ";
+	std::string text;
+	text.reserve(size + 64u);
+	const std::size_t tag_distance = (tags_per_kib == 0) ? size : (1024u / tags_per_kib);
+	std::size_t next_tag = tag_distance;
+	bool open = false;
+	while (text.size() < size) {
+		if (text.size() >= next_tag) {
+			text += open ? "</>" : "<red>";
+			open = !open;
+			next_tag += tag_distance;
+		}
+		else {
+			text += plain[text.size() % plain.size()];
+		}
+	}
+	if (open) {
+		text += "</>";
+	}
+	return text;
+}
+
+// the former in-place rewriting of style tags with replace_content()
+void in_place_rewrite(std::vector<char>& buf, std::size_t& num_of_chars) {
+	constexpr std::size_t buf_growth = 256u;
+	style_stack stack;
+	const style_snapshot_guard guard;
+	std::size_t n = num_of_chars;
+	std::size_t i = 0;
+	while(n > 0) {
+		const char* p = buf.data() + i;
+		const std::size_t pos = index_of(p, '<', n);
+		if (pos == no_pos) {
+			break;
+		}
+		std::size_t end = find_end_of_style_sequence(p + pos, n - pos);
+		if (end == invalid_end_of_sequence) {
+			i += (pos + 1);
+			n -= (pos + 1);
+			continue;
+		}
+		end += pos;
+		const std::string sequence{resolve_style_tag(guard.styles(), p + pos, end - pos, stack)}; // the former one returned a std::string
+		const auto num_of_chars_before = num_of_chars;
+		replace_content(buf, num_of_chars, i + pos, end-pos, sequence.c_str(), sequence.size(), buf_growth);
+		if (num_of_chars > num_of_chars_before) {
+			n += (num_of_chars - num_of_chars_before);
+		}
+		else {
+			n -= (num_of_chars_before - num_of_chars);
+		}
+		i += (pos + sequence.size());
+		n -= (pos + sequence.size());
+	}
+}
+
+// the former std::ostringstream based goto_xy()
+std::string baseline_goto_xy(int x, int y) {
+	std::ostringstream oss;
+	if ((x >= 0) && (y >= 0)) {
+		oss << "\x1B[" << (y + 1) << ';' << (x + 1) << 'H';
+	}
+	return oss.str();
+}
+
+// keys as a terminal sends them: letters, UTF-8, cursor and function keys, mouse reports
+std::string make_key_stream(std::size_t size) {
+	const char* const keys[] = { "a", "Z", " ", "\xC3\xA4", "\x1B[A", "\x1B[1;5C", "\x1BOP", "\x1B[15~", "\x1B[<0;12;34M", "\x1B[<32;13;34M", "\r", "\x1B" "b" };
+	std::string stream;
+	stream.reserve(size + 16u);
+	std::uint32_t random = 12345u;
+	while (stream.size() < size) {
+		random = (random * 1103515245u) + 12345u;
+		stream += keys[(random >> 16u) % (sizeof(keys) / sizeof(keys[0]))];
+	}
+	return stream;
+}
+
+// an ostream that throws everything away
+class null_buffer : public std::basic_streambuf<char> {
+protected:
+	int_type overflow(int_type ch = std::char_traits<char>::eof()) override {
+		return std::char_traits<char>::not_eof(ch);
+	}
+
+	std::streamsize xsputn(const char*, std::streamsize n) override {
+		return n;
+	}
+};
+
+void draw_frame(screen& s, int frame, int changed_rows_per_frame) {
+	static const char* const glyphs[] = { "#", "*", "\xE2\x96\x88", "o" };
+	for (int y = 0; y < changed_rows_per_frame; ++y) {
+		const int row = (frame + y) % s.rows();
+		for (int x = 0; x < s.columns(); ++x) {
+			cell& c = s.at(x, row);
+			const int v = x + row + frame;
+			std::memcpy(c.glyph, glyphs[v % 4], std::strlen(glyphs[v % 4]));
+			c.style.fore = static_cast<color>(v % 8);
+			c.style.intensity = ((v % 16) < 8) ? intensity::normal : intensity::bright;
+		}
+	}
+}
+
+struct counting_handler : vt_handler {
+	std::size_t count = 0;
+
+	void text(const char*, std::size_t n) {
+		count += n;
+	}
+
+	void sequence(const vt_sequence& s) {
+		count += s.final;
+	}
+};
+
+void bench_scanning() {
+	constexpr std::size_t size = 1024u * 1024u;
+	const std::string plain(size, 'x');
+	run("count_until_esc/plain_1MiB", "ns/byte", size, [&]() {
+		return count_until_esc(plain.data(), plain.size());
+	});
+	run("count_until_either/plain_1MiB", "ns/byte", size, [&]() {
+		return count_until_either(plain.data(), plain.size(), esc, '<');
+	});
+	const std::string sequences[] = { reset_all, fore::red, back::blue, "\x1B[1;31;44m", goto_xy(119, 49), "\x1B[2J", "\x1B[12", "\x1B[1;2;3;4;5;6;7;8;9;10m" };
+	constexpr int calls = 1000000;
+	run("find_end_of_esc_sequence", "ns/call", calls, [&]() {
+		std::size_t sum = 0;
+		for (int i = 0; i < calls; ++i) {
+			const std::string& s = sequences[i % 8];
+			sum += find_end_of_esc_sequence(s.data(), s.size());
+		}
+		return sum;
+	});
+	const std::string tags[] = { "<red>", "</>", "<green_on_blue>", "<a <3", "<warning_level>", "< >", "<x>", "</red>" };
+	run("find_end_of_style_sequence", "ns/call", calls, [&]() {
+		std::size_t sum = 0;
+		for (int i = 0; i < calls; ++i) {
+			const std::string& s = tags[i % 8];
+			sum += find_end_of_style_sequence(s.data(), s.size());
+		}
+		return sum;
+	});
+}
+
+void bench_sequences() {
+	constexpr int columns = 200;
+	constexpr int rows = 60;
+	constexpr double calls = static_cast<double>(columns) * rows;
+	const auto per_cell = [](auto&& func) {
+		return [func]() {
+			std::size_t sum = 0;
+			for (int y = 0; y < rows; ++y) {
+				for (int x = 0; x < columns; ++x) {
+					sum += func(x, y);
+				}
+			}
+			return sum;
+		};
+	};
+	char buf[max_sequence_len];
+	run("goto_xy/ostringstream_baseline", "ns/call", calls, per_cell([](int x, int y) { return baseline_goto_xy(x, y).size(); }));
+	run("goto_xy/std_string", "ns/call", calls, per_cell([](int x, int y) { return goto_xy(x, y).size(); }));
+	run("goto_xy/fixed", "ns/call", calls, per_cell([](int x, int y) { return fixed::goto_xy(x, y).size(); }));
+	run("goto_xy/buffer", "ns/call", calls, per_cell([&buf](int x, int y) { return static_cast<std::size_t>(goto_xy(buf, x, y) - buf); }));
+	char color_buf[max_color_sequence_len];
+	run("fore_color/rgb_to_ansi256", "ns/call", calls, per_cell([&color_buf](int x, int y) {
+		const rgb c{static_cast<std::uint8_t>(x), static_cast<std::uint8_t>(y * 4), static_cast<std::uint8_t>(x + y)};
+		return static_cast<std::size_t>(fore_color(color_buf, c, color_support::ansi256) - color_buf);
+	}));
+	run("fore_color/rgb_to_basic", "ns/call", calls, per_cell([&color_buf](int x, int y) {
+		const rgb c{static_cast<std::uint8_t>(x), static_cast<std::uint8_t>(y * 4), static_cast<std::uint8_t>(x + y)};
+		return static_cast<std::size_t>(fore_color(color_buf, c, color_support::basic) - color_buf);
+	}));
+}
+
+void bench_output_filters() {
+	constexpr std::size_t size = 256u * 1024u;
+	for (std::size_t tags_per_kib: { 0u, 16u, 256u }) {
+		const auto text = make_tagged_text(size, tags_per_kib);
+		const auto num_tags = static_cast<double>(std::count(text.begin(), text.end(), '<'));
+		const std::string density = std::to_string(tags_per_kib) + "_tags_per_KiB";
+		std::vector<char> buf;
+		run("replace_content/in_place_baseline/" + density, "ns/byte", static_cast<double>(text.size()), [&]() {
+			buf.assign(text.begin(), text.end());
+			std::size_t num_of_chars = buf.size();
+			in_place_rewrite(buf, num_of_chars);
+			return num_of_chars;
+		});
+		style_tag_rewriter rewriter;
+		std::vector<char> out;
+		run("style_tag_rewriter/" + density, "ns/byte", static_cast<double>(text.size()), [&]() {
+			out.clear();
+			rewriter.rewrite(text.data(), text.size(), out);
+			return out.size();
+		});
+		add_per_item("style_tag_rewriter/per_tag/" + density, "ns/tag", static_cast<double>(text.size()), num_tags);
+		std::vector<output_piece> pieces;
+		run("style_tag_rewriter/pieces/" + density, "ns/byte", static_cast<double>(text.size()), [&]() {
+			pieces.clear();
+			rewriter.rewrite(text.data(), text.size(), pieces);
+			return pieces.size();
+		});
+		add_per_item("style_tag_rewriter/pieces/per_tag/" + density, "ns/tag", static_cast<double>(text.size()), num_tags);
+	}
+	const auto lines = make_colored_lines(size, true);
+	std::vector<char> out;
+	out.reserve(lines.size());
+	sgr_filter filter;
+	run("sgr_filter/colored_lines", "ns/byte", static_cast<double>(lines.size()), [&]() {
+		out.clear();
+		filter.filter(lines.data(), lines.size(), out);
+		return out.size();
+	});
+	ansi_stripper stripper{strip_mode::all, true};
+	run("ansi_stripper/colored_lines", "ns/byte", static_cast<double>(lines.size()), [&]() {
+		out.clear();
+		stripper.filter(lines.data(), lines.size(), out);
+		return out.size();
+	});
+	vt_tokenizer tokenizer;
+	run("vt_tokenizer/colored_lines", "ns/byte", static_cast<double>(lines.size()), [&]() {
+		counting_handler handler;
+		tokenizer.feed(lines.data(), lines.size(), handler);
+		return handler.count;
+	});
+}
+
+void bench_input() {
+	const auto stream = make_key_stream(256u * 1024u);
+	run("key_decoder/mixed_keys", "ns/byte", static_cast<double>(stream.size()), [&]() {
+		key_decoder decoder;
+		key k;
+		std::size_t keys = 0;
+		for (const char c : stream) {
+			if (decoder.feed(c, k)) {
+				keys += static_cast<std::size_t>(k.special);
+			}
+		}
+		return keys;
+	});
+}
+
+void bench_screen() {
+	null_buffer discard;
+	std::ostream o{&discard};
+	constexpr int frames = 50;
+	screen s{terminal_size{200, 60}};
+	run("screen/full_redraw_200x60", "ns/frame", frames, [&]() {
+		for (int frame = 0; frame < frames; ++frame) {
+			draw_frame(s, frame, s.rows());
+			s.invalidate();
+			s.present(o);
+		}
+		return static_cast<std::size_t>(s.at(0, 0).glyph[0]);
+	});
+	run("screen/update_6_of_60_rows", "ns/frame", frames, [&]() {
+		for (int frame = 0; frame < frames; ++frame) {
+			draw_frame(s, frame, 6);
+			s.present(o);
+		}
+		return static_cast<std::size_t>(s.at(0, 0).glyph[0]);
+	});
+}
+
+void print_json(std::ostream& o) {
+	o << "{\n";
+	o << "  \"library\": \"ColorMyConsole\",\n";
+	o << "  \"version\": \"" << version_str << "\",\n";
+	o << "  \"repetitions\": " << repetitions << ",\n";
+	o << "  \"benchmarks\": [";
+	o << std::fixed << std::setprecision(4);
+	for (std::size_t i = 0; i < results.size(); ++i) {
+		o << ((i == 0) ? "\n" : ",\n");
+		o << "    { \"name\": \"" << results[i].name << "\", \"unit\": \"" << results[i].unit << "\", \"value\": " << results[i].value << " }";
+	}
+	o << "\n  ]\n}" << std::endl;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+	if (argc > 1) {
+		filter = argv[1];
+	}
+	add_style("red", fore::red);
+	bench_scanning();
+	bench_sequences();
+	bench_output_filters();
+	bench_input();
+	bench_screen();
+	print_json(std::cout);
+	return 0;
+}
@@ -48,6 +48,31 @@ int main() {
 			result = 1;
 		}
 	}
+	{ // scanning kernels: every length and match position, so the vector loops and the tails are covered
+		std::vector<char> v(300u, 'x');
+		for (std::size_t n = 0; n <= v.size(); ++n) {
+			if ((count_until(v.data(), n, esc) != n) || (count_until_either(v.data(), n, esc, '<') != n)) {
+				std::cout << "line " << __LINE__  << ": found a match where there is none";
+				result = 1;
+			}
+			for (std::size_t pos = 0; pos < n; ++pos) {
+				v[pos] = esc;
+				if ((count_until_esc(v.data(), n) != pos) || (count_until_either(v.data(), n, '<', esc) != pos)) {
+					std::cout << "line " << __LINE__  << ": esc not found at " << pos << " of " << n;
+					result = 1;
+				}
+				if (n > (pos + 1u)) {
+					v[pos + 1u] = '<';
+					if ((count_until(v.data(), n, '<') != (pos + 1u)) || (count_until_either(v.data(), n, esc, '<') != pos)) {
+						std::cout << "line " << __LINE__  << ": '<' not found after " << pos << " of " << n;
+						result = 1;
+					}
+					v[pos + 1u] = 'x';
+				}
+				v[pos] = 'x';
+			}
+		}
+	}
 	if (result == 0) {
 		std::cout << "All tests passed." << std::endl;
 	}
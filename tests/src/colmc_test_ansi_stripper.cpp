@@ -0,0 +1,81 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#include <iostream>
+#include <string>
+#include <vector>
+#include <colmc/sequences.h>
+#include <colmc/ansi_stripper.h>
+
+using namespace colmc;
+
+namespace {
+
+std::string strip(const std::string& text, std::size_t chunk_size, strip_mode mode, bool style_tags) {
+	ansi_stripper stripper{mode, style_tags};
+	std::vector<char> out;
+	for (std::size_t i = 0; i < text.size(); i += chunk_size) {
+		const auto n = std::min(chunk_size, text.size() - i);
+		stripper.filter(text.data() + i, n, out);
+	}
+	stripper.finish(out);
+	return std::string{out.data(), out.size()};
+}
+
+}
+
+int main() {
+	int result = 0;
+	const std::string text = std::string{"Normal "} + fore::red + "Red <red>" + back::blue + "Tag</> " + reset_all +
+	                         "\x1B[2J" + "a <3 b\x1B" + "x <gre";
+	const std::string all_stripped = "Normal Red Tag a <3 b <gre";
+	const std::string sgr_stripped = "Normal Red Tag \x1B[2Ja <3 b\x1Bx <gre";
+	const std::string tags_kept = std::string{"Normal Red <red>Tag</> a <3 b <gre"};
+	// sequences other than CSI, private ones and strings; an OSC 8 hyperlink longer than 32 bytes
+	const std::string others = "a\x1B[?25lb\x1B]0;title\x07""c\x1B(Bd\x1B""7e"
+	                           "\x1B]8;;https://example.com/a/path/that/is/rather/long\x1B\\link\x1B]8;;\x1B\\";
+	const std::string others_sgr_stripped = "a\x1B[?25lb\x1B]0;title\x07""c\x1B(Bd\x1B""7e"
+	                                        "\x1B]8;;https://example.com/a/path/that/is/rather/long\x1B\\link\x1B]8;;\x1B\\";
+	for (std::size_t chunk_size = 1; chunk_size <= others.size(); ++chunk_size) { // sequences split at every possible position
+		if ((chunk_size <= text.size()) && (strip(text, chunk_size, strip_mode::all, true) != all_stripped)) {
+			std::cout << "line " << __LINE__  << ": stripped text is wrong for chunk size " << chunk_size << std::endl;
+			result = 1;
+		}
+		if ((chunk_size <= text.size()) && (strip(text, chunk_size, strip_mode::sgr, true) != sgr_stripped)) {
+			std::cout << "line " << __LINE__  << ": SGR stripped text is wrong for chunk size " << chunk_size << std::endl;
+			result = 1;
+		}
+		if ((chunk_size <= text.size()) && (strip(text, chunk_size, strip_mode::all, false) != tags_kept)) {
+			std::cout << "line " << __LINE__  << ": style tags are stripped for chunk size " << chunk_size << std::endl;
+			result = 1;
+		}
+		if (strip(others, chunk_size, strip_mode::all, true) != "abcdelink") {
+			std::cout << "line " << __LINE__  << ": other sequences aren't stripped for chunk size " << chunk_size << std::endl;
+			result = 1;
+		}
+		if (strip(others, chunk_size, strip_mode::sgr, true) != others_sgr_stripped) {
+			std::cout << "line " << __LINE__  << ": other sequences aren't kept for chunk size " << chunk_size << std::endl;
+			result = 1;
+		}
+	}
+	// an incomplete sequence at the end is dropped, an incomplete style tag is text
+	if ((strip("b\x1B[12;", 3u, strip_mode::all, true) != "b") || (strip("b\x1B[3", 1u, strip_mode::sgr, true) != "b") ||
+	    (strip("b\x1B", 1u, strip_mode::all, true) != "b") || (strip("b<re", 1u, strip_mode::all, true) != "b<re")) {
+		std::cout << "line " << __LINE__  << ": incomplete sequence is wrong" << std::endl;
+		result = 1;
+	}
+	// a big text is copied in pieces as long as possible
+	std::string big(1000000u, 'x');
+	big.replace(500000u, 5u, fore::red);
+	if (strip(big, big.size(), strip_mode::all, true) != (std::string(500000u, 'x') + std::string(499995u, 'x'))) {
+		std::cout << "line " << __LINE__  << ": big text is wrong" << std::endl;
+		result = 1;
+	}
+	if (result == 0) {
+		std::cout << "All tests passed." << std::endl;
+	}
+	else {
+		std::cout << "Some tests failed." << std::endl;
+	}
+	std::cout << "Press return to terminate." << std::endl;
+	std::cin.get();
+	return result;
+}
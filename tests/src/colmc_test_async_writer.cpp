@@ -0,0 +1,93 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <colmc/posix/async_writer.h>
+
+using namespace colmc;
+
+namespace {
+
+constexpr unsigned num_threads = 4u;
+constexpr unsigned num_chunks = 5000u;
+
+std::string make_chunk(unsigned t, unsigned i) {
+	return '[' + std::to_string(t) + ':' + std::to_string(i) + std::string(i % 100u, 'x') + "]\n";
+}
+
+}
+
+int main() {
+	int result = 0;
+	int fds[2];
+	if (::pipe(fds) != 0) {
+		std::cout << "line " << __LINE__ << ": no pipe" << std::endl;
+		return 1;
+	}
+	std::string written;
+	std::thread reader{[&written, &fds]() {
+		char buf[4096];
+		ssize_t n;
+		while ((n = ::read(fds[0], buf, sizeof(buf))) > 0) {
+			written.append(buf, static_cast<std::size_t>(n));
+		}
+	}};
+	{
+		async_writer writer{fds[1], std::chrono::milliseconds{5}, 4096u}; // small ring: producers have to wait
+		std::vector<std::thread> producers;
+		for (unsigned t = 0; t < num_threads; ++t) {
+			producers.emplace_back([&writer, t]() {
+				for (unsigned i = 0; i < num_chunks; ++i) {
+					const std::string chunk = make_chunk(t, i);
+					writer.write(chunk.data(), chunk.size());
+				}
+			});
+		}
+		for (auto& producer : producers) {
+			producer.join();
+		}
+		const std::string big(10000u, 'y'); // larger than the ring
+		writer.write(big.data(), big.size());
+		writer.flush_and_wait();
+		writer.write("end\n", 4u); // written by the destructor
+	}
+	::close(fds[1]);
+	reader.join();
+	::close(fds[0]);
+
+	// the chunks arrive complete and the chunks of each thread in order
+	unsigned next[num_threads] = {};
+	std::size_t pos = 0;
+	while ((pos < written.size()) && (written[pos] == '[')) {
+		const unsigned t = static_cast<unsigned>(written[pos + 1u] - '0');
+		const std::string expected = make_chunk(t, (t < num_threads) ? next[t] : 0);
+		if ((t >= num_threads) || (written.compare(pos, expected.size(), expected) != 0)) {
+			std::cout << "line " << __LINE__ << ": garbled output at " << pos << std::endl;
+			result = 1;
+			break;
+		}
+		++next[t];
+		pos += expected.size();
+	}
+	for (unsigned t = 0; (result == 0) && (t < num_threads); ++t) {
+		if (next[t] != num_chunks) {
+			std::cout << "line " << __LINE__ << ": chunks of thread " << t << " missing" << std::endl;
+			result = 1;
+		}
+	}
+	if ((result == 0) && (written.compare(pos, std::string::npos, std::string(10000u, 'y') + "end\n") != 0)) {
+		std::cout << "line " << __LINE__ << ": end of the output is wrong" << std::endl;
+		result = 1;
+	}
+	if (result == 0) {
+		std::cout << "All tests passed." << std::endl;
+	}
+	else {
+		std::cout << "Some tests failed." << std::endl;
+	}
+	std::cout << "Press return to terminate." << std::endl;
+	std::cin.get();
+	return result;
+}
@@ -0,0 +1,74 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#include <iostream>
+#include <string>
+#include <colmc/colors.h>
+
+using namespace colmc;
+
+namespace {
+
+constexpr auto orange = fore::color(rgb{255, 128, 0});
+static_assert(orange.len == 17u, "sequence is built at compile time");
+
+std::string fore_string(rgb c, color_support support) {
+	char buf[max_color_sequence_len];
+	return std::string{buf, fore_color(buf, c, support)};
+}
+
+std::string back_string(color256 c, color_support support) {
+	char buf[max_color_sequence_len];
+	return std::string{buf, back_color(buf, c, support)};
+}
+
+}
+
+int main() {
+	int result = 0;
+	if ((std::string{orange} != "\x1B[38;2;255;128;0m") || (std::string{back::color(color256{0})} != "\x1B[48;5;0m")) {
+		std::cout << "line " << __LINE__  << ": constant sequence is wrong" << std::endl;
+		result = 1;
+	}
+	if ((detect_color_support("truecolor", "xterm") != color_support::truecolor) ||
+	    (detect_color_support(nullptr, "xterm-direct") != color_support::truecolor) ||
+	    (detect_color_support(nullptr, "xterm-256color") != color_support::ansi256) ||
+	    (detect_color_support(nullptr, "xterm") != color_support::basic) ||
+	    (detect_color_support(nullptr, "dumb") != color_support::none)) {
+		std::cout << "line " << __LINE__  << ": color support is detected wrong" << std::endl;
+		result = 1;
+	}
+	if ((to_ansi256(rgb{255, 0, 0}) != 196u) || (to_ansi256(rgb{0, 0, 0}) != 16u) || (to_ansi256(rgb{128, 128, 128}) != 244u) ||
+	    (to_ansi256(rgb{95, 135, 175}) != 67u) || (to_ansi256(rgb{250, 250, 250}) != 231u)) {
+		std::cout << "line " << __LINE__  << ": nearest palette color is wrong" << std::endl;
+		result = 1;
+	}
+	if ((to_ansi16(rgb{255, 0, 0}) != 9u) || (to_ansi16(rgb{0, 0, 0}) != 0u) || (to_ansi16(rgb{200, 10, 0}) != 1u) ||
+	    (to_ansi16(color256{196}) != 9u) || (to_ansi16(color256{4}) != 4u) || (to_ansi16(color256{232}) != 0u)) {
+		std::cout << "line " << __LINE__  << ": nearest basic color is wrong" << std::endl;
+		result = 1;
+	}
+	for (unsigned i = 16; i < 256u; ++i) { // the palette colors map to themselves
+		const auto index = static_cast<std::uint8_t>(i);
+		if (to_ansi256(to_rgb(color256{index})) != index) {
+			std::cout << "line " << __LINE__  << ": palette color " << i << " doesn't map to itself" << std::endl;
+			result = 1;
+		}
+	}
+	if ((fore_string(rgb{255, 0, 0}, color_support::truecolor) != "\x1B[38;2;255;0;0m") ||
+	    (fore_string(rgb{255, 0, 0}, color_support::ansi256) != "\x1B[38;5;196m") ||
+	    (fore_string(rgb{255, 0, 0}, color_support::basic) != "\x1B[91m") ||
+	    (!fore_string(rgb{255, 0, 0}, color_support::none).empty()) ||
+	    (back_string(color256{1}, color_support::basic) != "\x1B[41m") ||
+	    (back_string(color256{21}, color_support::truecolor) != "\x1B[48;5;21m")) {
+		std::cout << "line " << __LINE__  << ": written sequence is wrong" << std::endl;
+		result = 1;
+	}
+	if (result == 0) {
+		std::cout << "All tests passed." << std::endl;
+	}
+	else {
+		std::cout << "Some tests failed." << std::endl;
+	}
+	std::cout << "Press return to terminate." << std::endl;
+	std::cin.get();
+	return result;
+}
@@ -0,0 +1,91 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#include <iostream>
+#include <string>
+#include <colmc/coroutine.h>
+
+using namespace colmc;
+
+namespace {
+
+// Minimal coroutine type that starts right away and is never awaited itself
+struct task {
+	struct promise_type {
+		task get_return_object() {
+			return {};
+		}
+
+		std::suspend_never initial_suspend() noexcept {
+			return {};
+		}
+
+		std::suspend_never final_suspend() noexcept {
+			return {};
+		}
+
+		void return_void() {
+		}
+
+		void unhandled_exception() {
+			std::terminate();
+		}
+	};
+};
+
+key make_key(char c) {
+	key k;
+	k.special = key_enum::regular;
+	k.regular.bytes[0] = c;
+	return k;
+}
+
+task collect_two(key_dispatcher& dispatcher, std::string& collected) {
+	for (int i = 0; i < 2; ++i) {
+		const key k = co_await dispatcher.next_key();
+		collected += static_cast<std::string>(k);
+	}
+}
+
+task collect_all(key_dispatcher& dispatcher, std::string& collected, bool& done) {
+	auto stream = dispatcher.keys();
+	while (auto k = co_await stream.next()) {
+		collected += static_cast<std::string>(*k);
+	}
+	done = true;
+}
+
+}
+
+int main() {
+	int result = 0;
+	key_dispatcher dispatcher;
+	std::string first;
+	std::string second;
+	bool done = false;
+	collect_two(dispatcher, first); // both wait now
+	collect_all(dispatcher, second, done);
+	if (!dispatcher.has_waiters()) {
+		std::cout << "line " << __LINE__ << ": coroutines should wait for keys" << std::endl;
+		result = 1;
+	}
+	for (const char c : std::string{"abcde"}) {
+		dispatcher.post(make_key(c));
+	}
+	if ((first != "ac") || (second != "bde")) { // each key is handed out once, in the order of the awaits
+		std::cout << "line " << __LINE__ << ": keys handed out wrongly: " << first << " " << second << std::endl;
+		result = 1;
+	}
+	dispatcher.close();
+	if ((!done) || dispatcher.has_waiters()) {
+		std::cout << "line " << __LINE__ << ": close() should end the stream" << std::endl;
+		result = 1;
+	}
+	if (result == 0) {
+		std::cout << "All tests passed." << std::endl;
+	}
+	else {
+		std::cout << "Some tests failed." << std::endl;
+	}
+	std::cout << "Press return to terminate." << std::endl;
+	std::cin.get();
+	return result;
+}
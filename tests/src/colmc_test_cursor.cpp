@@ -0,0 +1,60 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#include <iostream>
+#include <string>
+#include <colmc/cursor.h>
+
+using namespace colmc;
+
+namespace {
+
+int result = 0;
+
+std::string move(cursor_planner& cursor, int x, int y, const std::string& overwrite = std::string{}) {
+	char buf[max_motion_len];
+	const char* end = cursor.move_to(buf, x, y, overwrite.empty() ? nullptr : overwrite.data(), overwrite.size());
+	return std::string{static_cast<const char*>(buf), end};
+}
+
+void check(int line, const std::string& actual, const std::string& expected) {
+	if (actual != expected) {
+		std::cout << "line " << line << ": motion is not equal to expected (" << actual.size() << " chars)" << std::endl;
+		result = 1;
+	}
+}
+
+}
+
+int main() {
+	cursor_planner cursor;
+	check(__LINE__, move(cursor, 0, 0), "\x1B[H"); // unknown position: absolute
+	check(__LINE__, move(cursor, 0, 0), "");
+	check(__LINE__, move(cursor, 0, 4), "\x1B[5H");
+	check(__LINE__, move(cursor, 20, 4), "\x1B[20C");
+	check(__LINE__, move(cursor, 18, 4), "\b\b");
+	check(__LINE__, move(cursor, 1, 4), "\r\x1B[C");
+	check(__LINE__, move(cursor, 0, 4), "\b");
+	check(__LINE__, move(cursor, 0, 5), "\r\n");
+	check(__LINE__, move(cursor, 0, 2), "\x1B[3H");
+	check(__LINE__, move(cursor, 0, 1), "\x1B[A");
+	check(__LINE__, move(cursor, 20, 1), "\x1B[20C");
+	check(__LINE__, move(cursor, 20, 2), "\x1B[B");
+	check(__LINE__, move(cursor, 1, 2), "\r\x1B[C");
+	check(__LINE__, move(cursor, 70, 40), "\x1B[41;71H");
+	check(__LINE__, move(cursor, 72, 40, "ab"), "ab"); // overwriting is shorter
+	check(__LINE__, move(cursor, 80, 40, "abcdefgh"), "\x1B[8C");
+	cursor.advance(5, 80);
+	if (cursor.known()) {
+		std::cout << "line " << __LINE__ << ": position should be unknown after the right border" << std::endl;
+		result = 1;
+	}
+	check(__LINE__, move(cursor, 5, 5), "\x1B[6;6H");
+	if (result == 0) {
+		std::cout << "All tests passed." << std::endl;
+	}
+	else {
+		std::cout << "Some tests failed." << std::endl;
+	}
+	std::cout << "Press return to terminate." << std::endl;
+	std::cin.get();
+	return result;
+}
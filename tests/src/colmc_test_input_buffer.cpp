@@ -0,0 +1,70 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#include <iostream>
+#include <cstring>
+#include <colmc/input_buffer.h>
+
+using namespace colmc;
+
+namespace {
+
+// writes n bytes starting with value first into the free space of the buffer
+std::size_t write(input_buffer& buf, std::size_t n, unsigned first) {
+	char* p[2];
+	std::size_t sizes[2];
+	const std::size_t num_ranges = buf.free_ranges(p, sizes);
+	std::size_t written = 0;
+	for (std::size_t r = 0; r < num_ranges; ++r) {
+		for (std::size_t i = 0; (i < sizes[r]) && (written < n); ++i) {
+			p[r][i] = static_cast<char>(first + written);
+			++written;
+		}
+	}
+	buf.commit(written);
+	return written;
+}
+
+}
+
+int main() {
+	int result = 0;
+	input_buffer buf;
+	if ((!buf.empty()) || (buf.free() != input_buffer::capacity)) {
+		std::cout << "line " << __LINE__ << ": new buffer should be empty" << std::endl;
+		result = 1;
+	}
+	unsigned next = 0;
+	for (int round = 0; round < 10; ++round) { // wraps around several times
+		const std::size_t n = (input_buffer::capacity / 3u) + static_cast<std::size_t>(round);
+		if (write(buf, n, next) != n) {
+			std::cout << "line " << __LINE__ << ": not all bytes were written" << std::endl;
+			result = 1;
+		}
+		for (std::size_t i = 0; i < n; ++i) {
+			if (buf[i] != static_cast<char>(next + i)) {
+				std::cout << "line " << __LINE__ << ": wrong byte in round " << round << std::endl;
+				result = 1;
+				break;
+			}
+		}
+		buf.consume(n);
+		next += static_cast<unsigned>(n);
+		if (!buf.empty()) {
+			std::cout << "line " << __LINE__ << ": buffer should be empty" << std::endl;
+			result = 1;
+		}
+	}
+	write(buf, input_buffer::capacity + 10u, 0);
+	if (buf.free() != 0) {
+		std::cout << "line " << __LINE__ << ": buffer should be full" << std::endl;
+		result = 1;
+	}
+	if (result == 0) {
+		std::cout << "All tests passed." << std::endl;
+	}
+	else {
+		std::cout << "Some tests failed." << std::endl;
+	}
+	std::cout << "Press return to terminate." << std::endl;
+	std::cin.get();
+	return result;
+}
@@ -0,0 +1,118 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#include <iostream>
+#include <string>
+#include <vector>
+#include <colmc/key_decoder.h>
+
+using namespace colmc;
+
+namespace {
+
+int result = 0;
+
+// decodes the bytes and flushes at the end
+std::vector<key> decode(const std::string& bytes) {
+	key_decoder decoder;
+	std::vector<key> keys;
+	key k;
+	for (const char c : bytes) {
+		if (decoder.feed(c, k)) {
+			keys.push_back(k);
+		}
+	}
+	if (decoder.flush(k)) {
+		keys.push_back(k);
+	}
+	return keys;
+}
+
+void check(int line, const std::string& bytes, const std::vector<std::string>& expected) {
+	const auto keys = decode(bytes);
+	bool ok = (keys.size() == expected.size());
+	for (std::size_t i = 0; ok && (i < keys.size()); ++i) {
+		ok = (static_cast<std::string>(keys[i]) == expected[i]);
+	}
+	if (!ok) {
+		std::cout << "line " << line << ": decoded keys are wrong:";
+		for (const auto& k : keys) {
+			std::cout << " '" << k << "'";
+		}
+		std::cout << std::endl;
+		result = 1;
+	}
+}
+
+}
+
+int main() {
+	check(__LINE__, "ab\xC3\xA4\xE2\x82\xAC", {"a", "b", "\xC3\xA4", "\xE2\x82\xAC"});
+	check(__LINE__, "\x1B[A\x1B[B\x1B[C\x1B[D\x1B[H\x1B[F", {"up", "down", "right", "left", "home", "end"});
+	check(__LINE__, "\x1BOA\x1BOH\x1BOP\x1BOS", {"up", "home", "f1", "f4"});
+	check(__LINE__, "\x1B[2~\x1B[3~\x1B[5~\x1B[6~\x1B[1~\x1B[4~", {"insert", "del", "page_up", "page_down", "home", "end"});
+	check(__LINE__, "\x1B[15~\x1B[17~\x1B[21~\x1B[23~\x1B[24~", {"f5", "f6", "f10", "f11", "f12"});
+	check(__LINE__, "\x1B[[A\x1B[[E", {"f1", "f5"}); // Linux console
+	check(__LINE__, "\x1B[1;5C\x1B[1;2A\x1B[3;3~\x1B[1;7P\x1BO5D", {"ctrl+right", "shift+up", "alt+del", "alt+ctrl+f1", "ctrl+left"});
+	check(__LINE__, "\x1B[Z", {"shift+\t"});
+	check(__LINE__, "\x1Bx\x1B\xC3\xA4\x1B\x1B[A", {"alt+x", "alt+\xC3\xA4", "alt+up"});
+	check(__LINE__, "\x1B", {"\x1B"}); // the ESC key
+	check(__LINE__, "\x1B\x1B", {"alt+\x1B"});
+	check(__LINE__, "\x1B[", {"alt+["});
+	check(__LINE__, "\x1B[99~a\x1B[1;5Xb\x1B[?1;2cc", {"unknown", "a", "unknown", "b", "unknown", "c"}); // unknown sequences are consumed completely
+	check(__LINE__, "\x1B[1\x1B[A", {"unknown", "up"});
+	check(__LINE__, "\xC3" "a", {"unknown"}); // broken UTF-8
+	check(__LINE__, "\x1B[<0;1;1M\x1B[<0;1;1m\x1B[<2;80;24M", {"mouse left press 0,0", "mouse left release 0,0", "mouse right press 79,23"}); // SGR (1006) mouse
+	check(__LINE__, "\x1B[<32;10;5M\x1B[<35;11;5M\x1B[<64;3;4M\x1B[<65;3;4M", {"mouse left move 9,4", "mouse none move 10,4", "mouse wheel_up press 2,3", "mouse wheel_down press 2,3"});
+	check(__LINE__, "\x1B[<20;1;2M\x1B[<9;1;2m\x1B[<128;1;1M", {"shift+ctrl+mouse left press 0,1", "alt+mouse middle release 0,1", "mouse back press 0,0"});
+	// bracketed paste, also taken in bulk
+	key_decoder decoder;
+	const std::string pasted = "\x1B[200~line 1\nESC: \x1B \x1B[20 \x1B[A\x1B[201\x1B[201~x";
+	key k;
+	std::size_t num_pastes = 0;
+	std::size_t i = 0;
+	while (i < pasted.size()) {
+		if (decoder.in_paste()) {
+			const std::size_t taken = decoder.feed_paste(pasted.data() + i, (pasted.size() - i) / 2u);
+			i += taken;
+			if (taken > 0) {
+				continue;
+			}
+		}
+		if (decoder.feed(pasted[i++], k)) {
+			if (k.special == key_enum::paste) {
+				++num_pastes;
+				if (decoder.pasted_text() != "line 1\nESC: \x1B \x1B[20 \x1B[A\x1B[201") {
+					std::cout << "line " << __LINE__ << ": pasted text is wrong" << std::endl;
+					result = 1;
+				}
+			}
+			else if (k != 'x') {
+				std::cout << "line " << __LINE__ << ": wrong key after the paste" << std::endl;
+				result = 1;
+			}
+		}
+	}
+	if (num_pastes != 1u) {
+		std::cout << "line " << __LINE__ << ": paste not recognized" << std::endl;
+		result = 1;
+	}
+
+	const auto keys = decode("\x1B[1;5C");
+	if ((keys.size() != 1u) || (keys[0] == key_enum::right) || (keys[0].special != key_enum::right) || (keys[0].modifiers != modifier::ctrl)) {
+		std::cout << "line " << __LINE__ << ": modifiers are wrong" << std::endl;
+		result = 1;
+	}
+	const auto clicks = decode("\x1B[<20;1;2M");
+	if ((clicks.size() != 1u) || (clicks[0] != key_enum::mouse) || (clicks[0].modifiers != (modifier::shift | modifier::ctrl))) {
+		std::cout << "line " << __LINE__ << ": a mouse event with modifiers isn't key_enum::mouse" << std::endl;
+		result = 1;
+	}
+	if (result == 0) {
+		std::cout << "All tests passed." << std::endl;
+	}
+	else {
+		std::cout << "Some tests failed." << std::endl;
+	}
+	std::cout << "Press return to terminate." << std::endl;
+	std::cin.get();
+	return result;
+}
@@ -0,0 +1,69 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#include <iostream>
+#include <thread>
+#include <colmc/key_queue.h>
+
+using namespace colmc;
+
+namespace {
+
+constexpr unsigned num_keys = 200000u;
+
+key make_key(unsigned i) {
+	key k;
+	k.special = key_enum::regular;
+	k.regular.bytes[0] = static_cast<char>('a' + (i % 26u));
+	k.modifiers = static_cast<std::uint8_t>(i % 16u);
+	return k;
+}
+
+}
+
+int main() {
+	int result = 0;
+	key_queue queue;
+	for (std::size_t i = 0; i < key_queue::capacity; ++i) {
+		queue.push(make_key(0));
+	}
+	if ((!queue.full()) || queue.push(make_key(0))) {
+		std::cout << "line " << __LINE__ << ": queue should be full" << std::endl;
+		result = 1;
+	}
+	key keys[key_queue::capacity];
+	if ((queue.pop(keys, key_queue::capacity + 1u) != key_queue::capacity) || (!queue.empty())) {
+		std::cout << "line " << __LINE__ << ": queue should be empty" << std::endl;
+		result = 1;
+	}
+	std::thread producer{[&queue]() {
+		for (unsigned i = 0; i < num_keys; ++i) {
+			while (!queue.push(make_key(i))) {
+				std::this_thread::yield();
+			}
+		}
+	}};
+	unsigned next = 0;
+	while (next < num_keys) { // keys arrive complete and in order
+		const std::size_t n = queue.pop(keys, 7u);
+		for (std::size_t i = 0; i < n; ++i) {
+			const key expected = make_key(next);
+			if ((keys[i].regular.bytes[0] != expected.regular.bytes[0]) || (keys[i].modifiers != expected.modifiers)) {
+				std::cout << "line " << __LINE__ << ": wrong key " << next << std::endl;
+				result = 1;
+			}
+			++next;
+		}
+		if (n == 0) {
+			std::this_thread::yield();
+		}
+	}
+	producer.join();
+	if (result == 0) {
+		std::cout << "All tests passed." << std::endl;
+	}
+	else {
+		std::cout << "Some tests failed." << std::endl;
+	}
+	std::cout << "Press return to terminate." << std::endl;
+	std::cin.get();
+	return result;
+}
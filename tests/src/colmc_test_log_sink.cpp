@@ -0,0 +1,118 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <limits.h>
+#include <colmc/setup.h>
+#include <colmc/log_sink.h>
+
+using namespace colmc;
+
+namespace {
+
+constexpr unsigned num_threads = 4u;
+constexpr unsigned num_lines = 2000u;
+
+// every 16th line of thread 0 is longer than what the kernel writes in one piece
+std::string padding(unsigned t, unsigned i) {
+	return ((t == 0) && ((i % 16u) == 0)) ? std::string(2u * PIPE_BUF, 'x') : std::string{};
+}
+
+}
+
+int main() {
+	int result = 0;
+	add_style("log_red", "\x1B[31m");
+	add_style("log_bold", "\x1B[1m");
+	int fds[2];
+	if (::pipe(fds) != 0) {
+		std::cout << "line " << __LINE__ << ": no pipe" << std::endl;
+		return 1;
+	}
+	std::string written;
+	std::thread reader{[&written, &fds]() {
+		char buf[4096];
+		ssize_t n;
+		while ((n = ::read(fds[0], buf, sizeof(buf))) > 0) {
+			written.append(buf, static_cast<std::size_t>(n));
+		}
+	}};
+	{
+		log_sink sink{fds[1]};
+		std::vector<std::thread> writers;
+		for (unsigned t = 0; t < num_threads; ++t) {
+			writers.emplace_back([&sink, t]() {
+				for (unsigned i = 0; i < num_lines; ++i) {
+					sink.line() << "<log_red>" << t << ' ' << i << padding(t, i) << " <log_bold>a < b";
+				}
+			});
+		}
+		for (auto& writer : writers) {
+			writer.join();
+		}
+		sink.write_line("plain\n");
+	}
+	::close(fds[1]);
+	reader.join();
+	::close(fds[0]);
+
+	// every line is complete, ends with the default style and the lines of a thread are in order
+	unsigned next[num_threads] = {};
+	std::size_t pos = 0;
+	std::size_t num_lines_read = 0;
+	while (pos < written.size()) {
+		const std::size_t end = written.find('\n', pos);
+		const std::string line = written.substr(pos, end - pos);
+		pos = (end == std::string::npos) ? written.size() : (end + 1u);
+		++num_lines_read;
+		if (line == "plain") {
+			continue;
+		}
+		const unsigned t = static_cast<unsigned>(line[9] - '0');
+		const unsigned i = (t < num_threads) ? next[t] : 0;
+		const std::string expected = "\x1B[0m\x1B[31m" + std::to_string(t) + ' ' + std::to_string(i) + padding(t, i) +
+		                             " \x1B[0m\x1B[1ma < b\x1B[0m";
+		if ((t >= num_threads) || (line != expected)) {
+			std::cout << "line " << __LINE__ << ": garbled line " << num_lines_read << std::endl;
+			result = 1;
+			break;
+		}
+		++next[t];
+	}
+	if (num_lines_read != (num_threads * num_lines) + 1u) {
+		std::cout << "line " << __LINE__ << ": " << num_lines_read << " lines instead of " << ((num_threads * num_lines) + 1u) << std::endl;
+		result = 1;
+	}
+
+	// what is still buffered for stdout comes before the first line written to it
+	const int old_stdout = ::dup(STDOUT_FILENO);
+	if ((::pipe(fds) != 0) || (::dup2(fds[1], STDOUT_FILENO) < 0)) {
+		std::cout << "line " << __LINE__ << ": no pipe" << std::endl;
+		return 1;
+	}
+	std::cout << "header "; // without newline, so it stays in the buffer of a terminal as well
+	std::printf("printf ");
+	log_sink{}.write_line("line\n");
+	::dup2(old_stdout, STDOUT_FILENO);
+	::close(old_stdout);
+	::close(fds[1]);
+	char buf[64];
+	const ssize_t num_read = ::read(fds[0], buf, sizeof(buf));
+	::close(fds[0]);
+	if (std::string(buf, (num_read > 0) ? static_cast<std::size_t>(num_read) : 0u) != "header printf line\n") {
+		std::cout << "line " << __LINE__ << ": stdout out of order" << std::endl;
+		result = 1;
+	}
+	if (result == 0) {
+		std::cout << "All tests passed." << std::endl;
+	}
+	else {
+		std::cout << "Some tests failed." << std::endl;
+	}
+	std::cout << "Press return to terminate." << std::endl;
+	std::cin.get();
+	return result;
+}
@@ -0,0 +1,94 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <colmc/setup.h>
+#include <colmc/raw_input.h>
+
+using namespace colmc;
+
+namespace {
+
+// stdin becomes the slave side of a pseudo terminal, the keys are typed into the master side
+int open_terminal() {
+	const int master = ::posix_openpt(O_RDWR | O_NOCTTY);
+	if ((master < 0) || (::grantpt(master) != 0) || (::unlockpt(master) != 0)) {
+		return -1;
+	}
+	const int slave = ::open(::ptsname(master), O_RDWR | O_NOCTTY);
+	if ((slave < 0) || (::dup2(slave, STDIN_FILENO) < 0)) {
+		return -1;
+	}
+	::close(slave);
+	return master;
+}
+
+bool is_regular(const key& k, char c) {
+	return ((k.special == key_enum::regular) && (k.regular == c));
+}
+
+}
+
+int main() {
+	int result = 0;
+	const int master = open_terminal();
+	if (master < 0) {
+		std::cout << "line " << __LINE__ << ": no pseudo terminal" << std::endl;
+		return 1;
+	}
+	config cfg;
+	cfg.raw_input_mode = true;
+	cfg.resize_events = true;
+	setup(cfg);
+
+	// the resize is reported after the keys that had been typed before it
+	::write(master, "ab", 2u);
+	if (!is_regular(get_key(), 'a')) {
+		std::cout << "line " << __LINE__ << ": a expected" << std::endl;
+		result = 1;
+	}
+	std::raise(SIGWINCH);
+	if (!is_regular(get_key(), 'b')) {
+		std::cout << "line " << __LINE__ << ": b expected" << std::endl;
+		result = 1;
+	}
+	if (get_key().special != key_enum::resize) {
+		std::cout << "line " << __LINE__ << ": resize expected" << std::endl;
+		result = 1;
+	}
+	// the resize has been taken, the next blocking read waits for a key
+	::write(master, "c", 1u);
+	if (!is_regular(get_key(), 'c')) {
+		std::cout << "line " << __LINE__ << ": c expected" << std::endl;
+		result = 1;
+	}
+
+	// a resize between two blocking reads
+	std::raise(SIGWINCH);
+	if (get_key().special != key_enum::resize) {
+		std::cout << "line " << __LINE__ << ": resize expected" << std::endl;
+		result = 1;
+	}
+	::write(master, "d", 1u);
+	if (!is_regular(get_key(), 'd')) {
+		std::cout << "line " << __LINE__ << ": d expected" << std::endl;
+		result = 1;
+	}
+	if (key_pressed()) {
+		std::cout << "line " << __LINE__ << ": no key expected" << std::endl;
+		result = 1;
+	}
+
+	if (result == 0) {
+		std::cout << "All tests passed." << std::endl;
+	}
+	else {
+		std::cout << "Some tests failed." << std::endl;
+	}
+	std::cout << "Press return to terminate." << std::endl;
+	::write(master, "\n", 1u); // stdin is still the pseudo terminal
+	std::cin.get();
+	return result;
+}
@@ -0,0 +1,60 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#include <iostream>
+#include <sstream>
+#include <colmc/screen.h>
+
+using namespace colmc;
+
+namespace {
+
+int result = 0;
+
+std::string present(screen& s) {
+	std::ostringstream oss;
+	s.present(oss);
+	return oss.str();
+}
+
+void check(int line, const std::string& actual, const std::string& expected) {
+	if (actual != expected) {
+		std::cout << "line " << line << ": output is not equal to expected" << std::endl;
+		result = 1;
+	}
+}
+
+}
+
+int main() {
+	screen s{terminal_size{10, 3}};
+	check(__LINE__, present(s), "\x1B[0m\x1B[2J"); // first present clears the terminal
+	check(__LINE__, present(s), ""); // nothing changed
+	cell_style red;
+	red.fore = color::red;
+	s.print(2, 1, "ab\xC3\xA4", red);
+	check(__LINE__, present(s), "\x1B[2;3H\x1B[31mab\xC3\xA4");
+	s.print(3, 1, "X", red); // only the changed cell is written
+	check(__LINE__, present(s), "\b\bX"); // cheaper than an absolute position
+	s.print(4, 1, "Y", red); // cursor is already there
+	s.print(5, 1, "Z");
+	check(__LINE__, present(s), "Y\x1B[0mZ");
+	if (s.print(8, 2, "long text") != 2) { // clipped
+		std::cout << "line " << __LINE__ << ": text not clipped" << std::endl;
+		result = 1;
+	}
+	check(__LINE__, present(s), "\x1B[3;9Hlo");
+	s.print(0, 0, "a");
+	s.print(3, 0, "b");
+	check(__LINE__, present(s), "\x1B[Ha  b"); // the blanks in between are written again
+	s.clear();
+	s.invalidate();
+	check(__LINE__, present(s), "\x1B[0m\x1B[2J");
+	if (result == 0) {
+		std::cout << "All tests passed." << std::endl;
+	}
+	else {
+		std::cout << "Some tests failed." << std::endl;
+	}
+	std::cout << "Press return to terminate." << std::endl;
+	std::cin.get();
+	return result;
+}
@@ -0,0 +1,61 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <colmc/sequences.h>
+
+using namespace colmc;
+
+namespace {
+
+int result = 0;
+
+void check(int line, const std::string& actual, const std::string& expected) {
+	if (actual != expected) {
+		std::cout << "line " << line << ": sequence is not equal to expected" << std::endl;
+		result = 1;
+	}
+}
+
+}
+
+int main() {
+	check(__LINE__, goto_xy(0, 0), "\x1B[1;1H");
+	check(__LINE__, goto_xy(79, 24), "\x1B[25;80H");
+	check(__LINE__, goto_xy(-1, 3), "");
+	check(__LINE__, up(3), "\x1B[3A");
+	check(__LINE__, down(12), "\x1B[12B");
+	check(__LINE__, forward(1), "\x1B[1C");
+	check(__LINE__, backward(0), "");
+	check(__LINE__, clear_screen(), "\x1B[2J");
+	check(__LINE__, clear_line(clear_line_mode::from_cursor_to_end_of_line), "\x1B[0K");
+	{ // longest possible sequence
+		const auto seq = fixed::goto_xy(2147483647, 2147483647);
+		check(__LINE__, seq, "\x1B[2147483648;2147483648H");
+		if (seq.size() != max_sequence_len) {
+			std::cout << "line " << __LINE__ << ": max_sequence_len is wrong" << std::endl;
+			result = 1;
+		}
+	}
+	{ // plain buffer
+		char buf[2u * max_sequence_len];
+		char* end = goto_xy(buf, 4, 2);
+		end = clear_line(end);
+		check(__LINE__, std::string(buf, end), "\x1B[3;5H\x1B[2K");
+	}
+	{ // output iterator
+		std::string s;
+		up(std::back_inserter(s), 7);
+		backward(std::back_inserter(s), 2);
+		check(__LINE__, s, "\x1B[7A\x1B[2D");
+	}
+	if (result == 0) {
+		std::cout << "All tests passed." << std::endl;
+	}
+	else {
+		std::cout << "Some tests failed." << std::endl;
+	}
+	std::cout << "Press return to terminate." << std::endl;
+	std::cin.get();
+	return result;
+}
@@ -0,0 +1,121 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#include <iostream>
+#include <string>
+#include <vector>
+#include <colmc/setup.h>
+#include <colmc/sequences.h>
+#include <colmc/sgr.h>
+#include <colmc/styles.h>
+#include <colmc/sgr_filter.h>
+
+using namespace colmc;
+
+namespace {
+
+std::string rewrite(const std::string& text) {
+	style_tag_rewriter rewriter;
+	std::vector<char> out;
+	rewriter.rewrite(text.data(), text.size(), out);
+	rewriter.finish(out);
+	return std::string{out.data(), out.size()};
+}
+
+std::string filter(const std::string& text, std::size_t chunk_size) {
+	sgr_filter f;
+	std::vector<char> out;
+	for (std::size_t i = 0; i < text.size(); i += chunk_size) {
+		const auto n = std::min(chunk_size, text.size() - i);
+		f.filter(text.data() + i, n, out);
+	}
+	f.finish(out);
+	return std::string{out.data(), out.size()};
+}
+
+int check(int line, const std::string& text, const std::string& expected) {
+	for (std::size_t chunk_size = 1; chunk_size <= text.size(); ++chunk_size) { // sequences split at every possible position
+		if (filter(text, chunk_size) != expected) {
+			std::cout << "line " << line << ": filtered text is wrong for chunk size " << chunk_size << std::endl;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+std::string commit(sgr_tracker& tracker) {
+	char buf[max_sgr_len];
+	return std::string{buf, tracker.commit(buf)};
+}
+
+}
+
+int main() {
+	int result = 0;
+	add_style("red", fore::red);
+	add_style("green_on_blue", std::string{back::blue} + fore::green);
+
+	// the tracker on its own
+	sgr_tracker tracker;
+	tracker.request(cell_style{color::red, color::reset, intensity::bright});
+	if (commit(tracker) != "\x1B[1;31m") {
+		std::cout << "line " << __LINE__  << ": wrong sequence" << std::endl;
+		result = 1;
+	}
+	if (!commit(tracker).empty()) {
+		std::cout << "line " << __LINE__  << ": nothing has changed, so nothing should be written" << std::endl;
+		result = 1;
+	}
+	tracker.request(cell_style{color::red, color::reset, intensity::dim});
+	if (commit(tracker) != "\x1B[22;2m") {
+		std::cout << "line " << __LINE__  << ": wrong sequence" << std::endl;
+		result = 1;
+	}
+	tracker.invalidate();
+	if (commit(tracker) != "\x1B[0;2;31m") {
+		std::cout << "line " << __LINE__  << ": unknown terminal state should be reset" << std::endl;
+		result = 1;
+	}
+
+	// redundant sequences are dropped, adjacent ones merged
+	result |= check(__LINE__, "\x1B[31m\x1B[31mA\x1B[31mB", "\x1B[31mAB");
+	result |= check(__LINE__, "\x1B[31m\x1B[44m\x1B[1mA", "\x1B[1;31;44mA");
+	result |= check(__LINE__, "A\x1B[31m\x1B[0mB", "AB");
+	result |= check(__LINE__, "\x1B[31mA\x1B[0m\x1B[32mB", "\x1B[31mA\x1B[32mB");
+
+	// nested style tags only change what differs
+	const std::string tagged = rewrite("<red>Red <green_on_blue>GreenOnBlue</> Red</> Normal");
+	result |= check(__LINE__, tagged, "\x1B[31mRed \x1B[32;44mGreenOnBlue\x1B[0;31m Red\x1B[0m Normal");
+
+	// untracked attributes (underline) and other sequences are passed through
+	result |= check(__LINE__, "\x1B[4mU\x1B[4mU\x1B[31mR\x1B[0mN", "\x1B[4mU\x1B[4mU\x1B[31mR\x1B[0mN");
+	result |= check(__LINE__, "\x1B[38;5;100mA\x1B[39mB", "\x1B[38;5;100mA\x1B[0mB");
+	result |= check(__LINE__, "\x1B[31m\x1B[2J\x1B[31mA", "\x1B[31m\x1B[2JA");
+	result |= check(__LINE__, "a\x1B[31", "a\x1B[31");
+	result |= check(__LINE__, "\x1Bx\x1B[?25l", "\x1Bx\x1B[?25l");
+	// sequences longer than 32 bytes and strings, split anywhere
+	result |= check(__LINE__, "\x1B[31mA\x1B[1;2;3;4;5;6;7;8;9;10;11;12;13;14;15H\x1B[31mB", "\x1B[31mA\x1B[1;2;3;4;5;6;7;8;9;10;11;12;13;14;15HB");
+	result |= check(__LINE__, "\x1B]8;;https://example.com/a/rather/long/path\x1B\\\x1B[31mlink", "\x1B]8;;https://example.com/a/rather/long/path\x1B\\\x1B[31mlink");
+	result |= check(__LINE__, "\x1B]0;title\a\x1B[31mA\x1B(B\x1B[31mB", "\x1B]0;title\a\x1B[31mA\x1B(BB");
+	// sequences (and string introducers) longer than vt_sequence::max_raw_len are kept whole
+	std::string params;
+	for (int i = 0; i < 30; ++i) {
+		params += std::to_string(i % 8) + ';';
+	}
+	const std::string long_sgr = "\x1B[" + params + "1m";
+	result |= check(__LINE__, "\x1B[31mA" + long_sgr + "B\x1B[31mC", "\x1B[31mA" + long_sgr + "\x1B[0;31mBC");
+	const std::string long_dcs = "\x1BP" + params + "1q#0;2;0;0;0\x1B\\";
+	result |= check(__LINE__, long_dcs + "\x1B[32m" + long_dcs + "\x1B[32mA", long_dcs + "\x1B[32m" + long_dcs + "A");
+
+	if (!get_current_style_stack().empty()) {
+		std::cout << "line " << __LINE__  << ": style stack is not empty";
+		result = 1;
+	}
+	if (result == 0) {
+		std::cout << "All tests passed." << std::endl;
+	}
+	else {
+		std::cout << "Some tests failed." << std::endl;
+	}
+	std::cout << "Press return to terminate." << std::endl;
+	std::cin.get();
+	return result;
+}
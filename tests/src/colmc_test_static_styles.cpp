@@ -0,0 +1,49 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#include <iostream>
+#include <string>
+#include <colmc/setup.h>
+#include <colmc/sequences.h>
+#include <colmc/static_styles.h>
+#include <colmc/styles.h>
+
+using namespace colmc;
+
+namespace {
+
+constexpr static_style test_styles[] = {
+	{ "red",           fore::red },
+	{ "green_on_blue", "\x1B[44m\x1B[32m" }
+};
+
+constexpr char literal[] = "Normal <red>Red <green_on_blue>GreenOnBlue</> Red</> Normal <a a<b %s";
+
+static_assert(styled_size(test_styles, "<red>x</>") == 4u + 5u + 1u + 4u, "tags have to be resolved at compile time");
+static_assert(styled<4u>(test_styles, "a<b ").chars[1] == '<', "a '<' that doesn't start a tag has to stay");
+
+}
+
+int main() {
+	int result = 0;
+	for (const auto& style: test_styles) {
+		add_style(style.name, style.escape_sequence);
+	}
+	style_tag_rewriter rewriter;
+	std::vector<char> out;
+	rewriter.rewrite(literal, sizeof(literal) - 1u, out);
+	rewriter.finish(out);
+	const std::string expected{out.data(), out.size()};
+	if (COLMC_STYLED(test_styles, literal) != expected) {
+		std::cout << "line " << __LINE__  << ": compile time result differs from the run time result";
+		result = 1;
+	}
+	std::cout << COLMC_STYLED(test_styles, "Normal <red>Red <green_on_blue>GreenOnBlue</> Red</> Normal") << std::endl;
+	if (result == 0) {
+		std::cout << "All tests passed." << std::endl;
+	}
+	else {
+		std::cout << "Some tests failed." << std::endl;
+	}
+	std::cout << "Press return to terminate." << std::endl;
+	std::cin.get();
+	return result;
+}
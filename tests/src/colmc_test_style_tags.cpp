@@ -0,0 +1,199 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#include <iostream>
+#include <string>
+#include <thread>
+#include <colmc/setup.h>
+#include <colmc/sequences.h>
+#include <colmc/styles.h>
+
+using namespace colmc;
+
+namespace {
+
+std::string rewrite(const std::string& text, std::size_t chunk_size) {
+	style_tag_rewriter rewriter;
+	std::vector<char> out;
+	for (std::size_t i = 0; i < text.size(); i += chunk_size) {
+		const auto n = std::min(chunk_size, text.size() - i);
+		rewriter.rewrite(text.data() + i, n, out);
+	}
+	rewriter.finish(out);
+	return std::string{out.data(), out.size()};
+}
+
+// the same with the pieces that refer to the text instead of copying it
+std::string rewrite_to_pieces(const std::string& text, std::size_t chunk_size) {
+	style_tag_rewriter rewriter;
+	std::vector<output_piece> pieces;
+	std::string result;
+	for (std::size_t i = 0; i < text.size(); i += chunk_size) {
+		const auto n = std::min(chunk_size, text.size() - i);
+		pieces.clear();
+		rewriter.rewrite(text.data() + i, n, pieces);
+		for (const auto& piece : pieces) {
+			if ((piece.text != nullptr) && ((piece.text < text.data()) || (piece.text >= text.data() + text.size()))) {
+				return "piece outside of the text";
+			}
+			result.append((piece.text != nullptr) ? piece.text : (rewriter.sequences().data() + piece.offset), piece.size);
+		}
+	}
+	std::vector<char> out;
+	rewriter.finish(out);
+	return result + std::string{out.data(), out.size()};
+}
+
+}
+
+int main() {
+	int result = 0;
+	add_style("red", fore::red);
+	add_style("green_on_blue", std::string{back::blue} + fore::green);
+	const std::string text = "Normal <red>Red <green_on_blue>GreenOnBlue <unknown>Unknown</> GreenOnBlue</> Red</> Normal <a <3 a<b <red";
+	const std::string expected = std::string{"Normal "} + reset_all + fore::red + "Red " +
+	                             reset_all + back::blue + fore::green + "GreenOnBlue " +
+	                             "Unknown" + reset_all + back::blue + fore::green + " GreenOnBlue" +
+	                             reset_all + fore::red + " Red" + reset_all + " Normal <a <3 a<b <red";
+	for (std::size_t chunk_size = 1; chunk_size <= text.size(); ++chunk_size) { // tags split at every possible position
+		const auto rewritten = rewrite(text, chunk_size);
+		if (rewritten != expected) {
+			std::cout << "line " << __LINE__  << ": rewritten text is wrong for chunk size " << chunk_size << std::endl;
+			result = 1;
+		}
+		if (rewrite_to_pieces(text, chunk_size) != expected) {
+			std::cout << "line " << __LINE__  << ": pieces are wrong for chunk size " << chunk_size << std::endl;
+			result = 1;
+		}
+	}
+	// the longest tag there may be is taken wherever the text is split, one char more is text
+	add_style("fifteen_letters", fore::yellow);
+	const std::string longest = "a<fifteen_letters>b</>c<sixteen_letters_>";
+	const std::string longest_expected = std::string{"a"} + reset_all + fore::yellow + 'b' + reset_all + "c<sixteen_letters_>";
+	for (std::size_t chunk_size = 1; chunk_size <= longest.size(); ++chunk_size) {
+		if (rewrite(longest, chunk_size) != longest_expected) {
+			std::cout << "line " << __LINE__  << ": longest tag is wrong for chunk size " << chunk_size << std::endl;
+			result = 1;
+		}
+	}
+	for (std::size_t split = 1; split < longest.size(); ++split) {
+		style_tag_rewriter split_rewriter;
+		std::vector<char> split_out;
+		split_rewriter.rewrite(longest.data(), split, split_out);
+		split_rewriter.rewrite(longest.data() + split, longest.size() - split, split_out);
+		split_rewriter.finish(split_out);
+		if (std::string{split_out.data(), split_out.size()} != longest_expected) {
+			std::cout << "line " << __LINE__  << ": longest tag is wrong when split at " << split << std::endl;
+			result = 1;
+		}
+	}
+	// each stream has a stack of its own
+	style_tag_rewriter first;
+	style_tag_rewriter second;
+	std::vector<char> out;
+	first.rewrite("<red>a<green_on_blue>b", 22u, out);
+	second.rewrite("<red>c", 6u, out);
+	out.clear();
+	second.rewrite("</>", 3u, out);
+	first.rewrite("</>", 3u, out);
+	if ((std::string{out.data(), out.size()} != (std::string{reset_all} + reset_all + fore::red)) || (first.stack().view().size() != 1u) ||
+	    (first.stack().view()[0] != "red") || (!second.stack().empty())) {
+		std::cout << "line " << __LINE__  << ": streams share their style stack" << std::endl;
+		result = 1;
+	}
+	// ... or each thread
+	use_thread_local_style_stacks(true);
+	first.rewrite("<green_on_blue>", 15u, out);
+	std::thread other{[&second]() {
+		std::vector<char> other_out;
+		second.rewrite("<red>", 5u, other_out);
+	}};
+	other.join();
+	const style_stack_view current = get_current_style_stack_view(); // the thread's stack without setup()
+	if ((current.size() != 1u) || (current[0] != "green_on_blue")) {
+		std::cout << "line " << __LINE__  << ": threads share their style stack" << std::endl;
+		result = 1;
+	}
+	first.rewrite("<not_a_style>", 13u, out); // unknown styles keep their names
+	if (get_current_style_stack() != std::vector<std::string>{"green_on_blue", "not_a_style"}) {
+		std::cout << "line " << __LINE__  << ": wrong names in the style stack" << std::endl;
+		result = 1;
+	}
+	thread_style_stack().clear();
+	use_thread_local_style_stacks(false);
+	// nested deeper than the capacity of the stack
+	std::string deep;
+	for (std::size_t i = 0; i < style_stack::capacity + 2u; ++i) {
+		deep += "<red>";
+	}
+	for (std::size_t i = 0; i < style_stack::capacity + 2u; ++i) {
+		deep += "</>";
+	}
+	style_tag_rewriter deep_rewriter;
+	deep_rewriter.rewrite(deep.data(), deep.size(), out);
+	if (!deep_rewriter.stack().empty()) {
+		std::cout << "line " << __LINE__  << ": end tags don't match" << std::endl;
+		result = 1;
+	}
+	// the registry is published as snapshots; readers use them while styles are added
+	std::thread writer{[]() {
+		for (char c = 'a'; c <= 'z'; ++c) {
+			add_style(std::string{"many_"} + c, fore::blue);
+		}
+	}};
+	for (int i = 0; i < 1000; ++i) {
+		if (rewrite("<red>x</>", 3u) != (std::string{reset_all} + fore::red + 'x' + reset_all)) {
+			std::cout << "line " << __LINE__  << ": wrong while styles are added" << std::endl;
+			result = 1;
+			break;
+		}
+	}
+	writer.join();
+	if ((get_style("many_z") != fore::blue) || (!remove_style("red")) || remove_style("red") || (!get_style("red").empty())) {
+		std::cout << "line " << __LINE__  << ": add or remove is wrong" << std::endl;
+		result = 1;
+	}
+	if ((rewrite("<red>x", 2u) != "x") || (!add_style("red", fore::green)) || (rewrite("<red>x", 2u) != (std::string{reset_all} + fore::green + 'x'))) {
+		std::cout << "line " << __LINE__  << ": removed style is still used" << std::endl;
+		result = 1;
+	}
+	// replaced snapshots are freed as soon as no reader uses them
+	{
+		const style_snapshot_guard guard;
+		const std::string_view red = guard.styles().sequence(guard.styles().find("red"));
+		for (int i = 0; i < 100; ++i) {
+			add_style("churn", fore::blue);
+			remove_style("churn");
+		}
+		if ((num_retired_snapshots() != 1u) || (red != fore::green)) {
+			std::cout << "line " << __LINE__  << ": the snapshot in use is freed or others are kept" << std::endl;
+			result = 1;
+		}
+	}
+	add_style("churn", fore::blue);
+	if (num_retired_snapshots() != 0u) {
+		std::cout << "line " << __LINE__  << ": unused snapshots are kept" << std::endl;
+		result = 1;
+	}
+	std::thread reader{[&result]() {
+		for (int i = 0; i < 1000; ++i) {
+			if (rewrite("<red>x</>", 3u) != (std::string{reset_all} + fore::green + 'x' + reset_all)) {
+				std::cout << "line " << __LINE__  << ": wrong while snapshots are freed" << std::endl;
+				result = 1;
+				break;
+			}
+		}
+	}};
+	for (int i = 0; i < 1000; ++i) {
+		remove_style("churn");
+		add_style("churn", fore::blue);
+	}
+	reader.join();
+	if (result == 0) {
+		std::cout << "All tests passed." << std::endl;
+	}
+	else {
+		std::cout << "Some tests failed." << std::endl;
+	}
+	std::cout << "Press return to terminate." << std::endl;
+	std::cin.get();
+	return result;
+}
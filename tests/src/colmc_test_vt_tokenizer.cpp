@@ -0,0 +1,126 @@
+// (c) 2021 Jens Ganter-Benzing. Licensed under the MIT license.
+#include <iostream>
+#include <string>
+#include <colmc/vt_tokenizer.h>
+
+using namespace colmc;
+
+namespace {
+
+// writes the tokens in a readable form
+struct recorder : vt_handler {
+	std::string tokens;
+
+	void text(const char* p, std::size_t n) {
+		if ((!tokens.empty()) && (tokens.back() != ']')) {
+			tokens.append(p, n); // text reported in several pieces
+		}
+		else {
+			tokens += "text:";
+			tokens.append(p, n);
+		}
+	}
+
+	void sequence(const vt_sequence& s) {
+		static const char* const kinds[] = { "esc", "csi", "ss3" };
+		tokens += std::string{"["} + kinds[static_cast<int>(s.kind)];
+		if (s.private_marker != '\0') {
+			tokens += s.private_marker;
+		}
+		for (std::size_t i = 0; i < s.num_params; ++i) {
+			tokens += ' ' + std::to_string(s.params[i]);
+		}
+		tokens += ' ';
+		tokens.append(s.intermediates, s.num_intermediates);
+		tokens += s.final;
+		if (s.malformed) {
+			tokens += '!';
+		}
+		if (std::string{s.raw_data(), s.raw_len}.find('\x1B', 1u) != std::string::npos) {
+			tokens += " raw has two ESCs";
+		}
+		tokens += ']';
+	}
+
+	void string_begin(const vt_sequence& s) {
+		tokens += "[string " + std::to_string(static_cast<int>(s.kind)) + ' ';
+		if (s.final != '\0') { // only DCS has one
+			tokens += s.final;
+		}
+		tokens += ':';
+	}
+
+	void string_data(const char* p, std::size_t n) {
+		tokens.append(p, n);
+	}
+
+	void string_end(vt_string_end end) {
+		static const char* const ends[] = { " cancelled]", "]", " bel]" };
+		tokens += ends[static_cast<int>(end)];
+	}
+};
+
+std::string tokenize(const std::string& text, std::size_t chunk_size) {
+	vt_tokenizer tokenizer;
+	recorder r;
+	for (std::size_t i = 0; i < text.size(); i += chunk_size) {
+		tokenizer.feed(text.data() + i, std::min(chunk_size, text.size() - i), r);
+	}
+	tokenizer.finish(r);
+	return r.tokens;
+}
+
+}
+
+int main() {
+	int result = 0;
+	const std::string text = "a\x1B[1;31mb\x1B[?25l\x1B[38:2::255:0:0m\x1B[;5H\x1B(B\x1B" "7\x1BOP"
+	                         "\x1B]0;title\a\x1B]8;;link\x1B\\\x1BP1$rq\x1B\\\x1B_apc\x1B[m"
+	                         "\x1B[1\n2m\x1B[1\x1B[2m\x1B[1?2m\x1B[1\x18x\x1B";
+	const std::string expected = "text:a[csi 1 31 m]text:b[csi? 25 l][csi 38 2 0 255 0 0 m][csi 0 5 H][esc (B][esc 7][ss3 P]"
+	                             "[string 3 :0;title bel][string 3 :8;;link][string 4 r:q][string 7 :apc cancelled][csi m]"
+	                             "text:\n[csi 12 m][csi 2 m][csi 1 m!]text:\x18x\x1B";
+	for (std::size_t chunk_size = 1; chunk_size <= text.size(); ++chunk_size) { // sequences split at every possible position
+		const auto tokens = tokenize(text, chunk_size);
+		if (tokens != expected) {
+			std::cout << "line " << __LINE__  << ": tokens are wrong for chunk size " << chunk_size << ": " << tokens << std::endl;
+			result = 1;
+			break;
+		}
+	}
+	// raw bytes of a sequence and params beyond the limits
+	vt_tokenizer tokenizer;
+	struct last_sequence : vt_handler {
+		vt_sequence seq;
+		void sequence(const vt_sequence& s) {
+			seq = s;
+		}
+	} last;
+	const std::string lone = "\x1B[31m"; // nothing after the final byte
+	tokenizer.feed(lone.data(), lone.size(), last);
+	if ((last.seq.num_params != 1u) || (last.seq.param(0, 0u) != 31u) || (last.seq.final != 'm') || (std::string{last.seq.raw_data(), last.seq.raw_len} != lone)) {
+		std::cout << "line " << __LINE__  << ": lone sequence is wrong" << std::endl;
+		result = 1;
+	}
+	const std::string many = "\x1B[1;2;3;4;5;6;7;8;9;10;11;12;13;14;15;16;17m";
+	tokenizer.feed(many.data(), many.size(), last);
+	if ((!last.seq.malformed) || (last.seq.num_params != vt_sequence::max_params) || (std::string{last.seq.raw, last.seq.raw_len} != many)) {
+		std::cout << "line " << __LINE__  << ": too many params aren't detected" << std::endl;
+		result = 1;
+	}
+	const std::string big = "\x1B[" + std::string(100u, '1') + 'm';
+	tokenizer.feed(big.data(), big.size(), last);
+	if ((std::string{last.seq.raw_data(), last.seq.raw_len} != big) || (last.seq.param(0, 1u) != 0xFFFFu)) {
+		std::cout << "line " << __LINE__  << ": long sequence is wrong" << std::endl;
+		result = 1;
+	}
+	if (result == 0) {
+		std::cout << "All tests passed." << std::endl;
+	}
+	else {
+		std::cout << "Some tests failed." << std::endl;
+	}
+	std::cout << "Press return to terminate." << std::endl;
+	std::cin.get();
+	return result;
+}